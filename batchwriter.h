@@ -0,0 +1,121 @@
+#ifndef BATCHWRITER_H
+#define BATCHWRITER_H
+
+#include "mpscqueue.h"
+#include "noncopyable.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Passes items from any number of threads to one background thread, which hands them on in batches so that the producers never block on I/O.
+// A batch is taken each time the flush interval passes, or sooner once the queue fills halfway; while the queue is full, items are dropped and counted instead.
+template<typename T> class BatchWriter : public NonCopyable {
+	public:
+		// Called on the background thread with the items queued since the last batch, oldest first, and how many were dropped since then.
+		// Never called with no items and nothing dropped.
+		typedef std::function<void(std::vector<T> &items, uint64_t dropped)> Sink;
+
+		BatchWriter(std::size_t capacity, std::chrono::milliseconds flush_interval, const Sink &sink);
+
+		// Stops the background thread if it is still running.
+		~BatchWriter();
+
+		// Starts the background thread; items pushed before then go out in the first batch.
+		void start();
+
+		// Hands everything still queued to the sink, then stops the background thread.
+		// The owner must call this before destroying anything the sink uses.
+		void stop();
+
+		// May be called from any thread.
+		// Returns false if the queue is full and the item was dropped.
+		bool push(T &&item);
+
+	private:
+		MPSCQueue<T> queue;
+		std::atomic<uint64_t> dropped;
+		const std::chrono::milliseconds flush_interval;
+		const Sink sink;
+		std::vector<T> batch;
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool stopping;
+		std::thread thread;
+
+		void run();
+		void drain();
+};
+
+
+
+template<typename T> BatchWriter<T>::BatchWriter(std::size_t capacity, std::chrono::milliseconds flush_interval, const Sink &sink) :
+		queue(capacity),
+		dropped(0),
+		flush_interval(flush_interval),
+		sink(sink),
+		stopping(false) {
+}
+
+template<typename T> BatchWriter<T>::~BatchWriter() {
+	stop();
+}
+
+template<typename T> void BatchWriter<T>::start() {
+	thread = std::thread(&BatchWriter::run, this);
+}
+
+template<typename T> void BatchWriter<T>::stop() {
+	if (!thread.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	cond.notify_all();
+	thread.join();
+}
+
+template<typename T> bool BatchWriter<T>::push(T &&item) {
+	if (!queue.push(std::move(item))) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	if (queue.size() >= queue.capacity() / 2) {
+		cond.notify_one();
+	}
+	return true;
+}
+
+template<typename T> void BatchWriter<T>::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopping) {
+		cond.wait_for(lock, flush_interval);
+		lock.unlock();
+		drain();
+		lock.lock();
+	}
+	lock.unlock();
+	drain();
+}
+
+template<typename T> void BatchWriter<T>::drain() {
+	uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+	T item;
+	while (queue.pop(item)) {
+		batch.push_back(std::move(item));
+	}
+	if (!batch.empty() || lost) {
+		sink(batch, lost);
+	}
+	batch.clear();
+}
+
+#endif
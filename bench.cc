@@ -0,0 +1,707 @@
+#include "configuration.h"
+#include "engine.h"
+#include "exception.h"
+#include "gamecontroller.h"
+#include "legacypublisher.h"
+#include "logger.h"
+#include "protobufpublisher.h"
+#include "publisher.h"
+#include "rconsrv.h"
+#include "referee.pb.h"
+#include "savegame.h"
+#include "savestate.pb.h"
+#include "timing.h"
+#include "udpbroadcast.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <initializer_list>
+#include <ios>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <giomm/init.h>
+#include <glibmm/dispatcher.h>
+#include <glibmm/exception.h>
+#include <glibmm/main.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/optioncontext.h>
+#include <glibmm/optionentry.h>
+#include <glibmm/optiongroup.h>
+#include <glibmm/ustring.h>
+#include <google/protobuf/stubs/common.h>
+
+#ifndef WIN32
+#include "descriptor.h"
+#include "rcon.pb.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#endif
+
+namespace {
+	std::atomic<uint64_t> allocation_count(0);
+}
+
+// Count every heap allocation, so that benchmarks can report how many each operation makes.
+void *operator new(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	void *p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+namespace {
+	struct Options {
+		Glib::ustring filter;
+		double scale;
+		int clients;
+		std::string scratch;
+		std::ostream *results;
+	};
+
+	// The game states the benchmarks run against, each typical of a different part of a match.
+	enum class Fixture {
+		PRE_GAME,
+		SECOND_HALF,
+		SHOOTOUT,
+	};
+
+	const Fixture ALL_FIXTURES[] = {Fixture::PRE_GAME, Fixture::SECOND_HALF, Fixture::SHOOTOUT};
+
+	const char *fixture_name(Fixture fixture) {
+		switch (fixture) {
+			case Fixture::PRE_GAME: return "pre_game";
+			case Fixture::SECOND_HALF: return "second_half";
+			case Fixture::SHOOTOUT: return "shootout";
+		}
+		throw std::logic_error("Impossible fixture!");
+	}
+
+	void set_team(SSL_Referee::TeamInfo &ti, const char *name, unsigned int score, unsigned int red_cards, std::initializer_list<uint32_t> yellow_card_times, unsigned int yellow_cards, unsigned int timeouts, uint32_t timeout_time, unsigned int goalie) {
+		ti.set_name(name);
+		ti.set_score(score);
+		ti.set_red_cards(red_cards);
+		ti.clear_yellow_card_times();
+		for (uint32_t time : yellow_card_times) {
+			ti.add_yellow_card_times(time);
+		}
+		ti.set_yellow_cards(yellow_cards);
+		ti.set_timeouts(timeouts);
+		ti.set_timeout_time(timeout_time);
+		ti.set_goalie(goalie);
+	}
+
+	// Builds a fixture with fixed contents, so that results from different builds are comparable.
+	SaveState make_fixture(Fixture fixture, const Configuration &configuration) {
+		const uint32_t full_timeout_time = configuration.normal_timeout_seconds * 1000000U;
+		SaveState ss;
+		SSL_Referee &ref = *ss.mutable_referee();
+		ref.set_packet_timestamp(1500000000000000ULL);
+		ref.set_blueteamonpositivehalf(false);
+		switch (fixture) {
+			case Fixture::PRE_GAME:
+				ref.set_stage(SSL_Referee::NORMAL_FIRST_HALF_PRE);
+				ref.set_command(SSL_Referee::HALT);
+				ref.set_command_counter(2);
+				ref.set_command_timestamp(1499999990000000ULL);
+				set_team(*ref.mutable_yellow(), u8"ER-Force", 0, 0, {}, 0, configuration.normal_timeouts, full_timeout_time, 1);
+				set_team(*ref.mutable_blue(), u8"TIGERs Mannheim", 0, 0, {}, 0, configuration.normal_timeouts, full_timeout_time, 0);
+				ss.set_yellow_penalty_goals(0);
+				ss.set_blue_penalty_goals(0);
+				ss.set_time_taken(0);
+				break;
+
+			case Fixture::SECOND_HALF:
+				// The clocks are running with cards and a timeout already used on both sides.
+				ref.set_stage(SSL_Referee::NORMAL_SECOND_HALF);
+				ref.set_stage_time_left(187000000);
+				ref.set_command(SSL_Referee::NORMAL_START);
+				ref.set_command_counter(87);
+				ref.set_command_timestamp(1499999995000000ULL);
+				set_team(*ref.mutable_yellow(), u8"ER-Force", 3, 0, {61000000, 104000000}, 3, configuration.normal_timeouts - 1, full_timeout_time - 47000000, 1);
+				set_team(*ref.mutable_blue(), u8"TIGERs Mannheim", 2, 1, {12000000}, 2, configuration.normal_timeouts - 2, full_timeout_time - 131000000, 0);
+				ref.mutable_gameevent()->set_gameeventtype(SSL_Referee_Game_Event::ATTACKER_IN_DEFENSE_AREA);
+				ref.mutable_gameevent()->mutable_originator()->set_team(SSL_Referee_Game_Event::TEAM_BLUE);
+				ref.mutable_gameevent()->mutable_originator()->set_botid(4);
+				ref.mutable_gameevent()->set_message(u8"Attacker touched the ball in the defense area");
+				ss.set_yellow_penalty_goals(0);
+				ss.set_blue_penalty_goals(0);
+				ss.set_time_taken(1113000000);
+				ss.mutable_last_card()->set_team(SaveState::TEAM_YELLOW);
+				ss.mutable_last_card()->set_card(SaveState::CARD_YELLOW);
+				ss.mutable_last_timeout()->set_team(SaveState::TEAM_BLUE);
+				ss.mutable_last_timeout()->set_left_before(full_timeout_time - 97000000);
+				break;
+
+			case Fixture::SHOOTOUT:
+				// A long match with a ball placement in progress.
+				ref.set_stage(SSL_Referee::PENALTY_SHOOTOUT);
+				ref.set_command(SSL_Referee::BALL_PLACEMENT_BLUE);
+				ref.set_command_counter(241);
+				ref.set_command_timestamp(1499999999000000ULL);
+				ref.mutable_designated_position()->set_x(-3000.0f);
+				ref.mutable_designated_position()->set_y(0.0f);
+				set_team(*ref.mutable_yellow(), u8"ER-Force", 4, 1, {}, 5, 0, 0, 1);
+				set_team(*ref.mutable_blue(), u8"TIGERs Mannheim", 4, 1, {}, 4, 1, 12000000, 0);
+				ref.mutable_gameevent()->set_gameeventtype(SSL_Referee_Game_Event::BALL_PLACEMENT_FAILED);
+				ref.mutable_gameevent()->mutable_originator()->set_team(SSL_Referee_Game_Event::TEAM_YELLOW);
+				ss.set_yellow_penalty_goals(3);
+				ss.set_blue_penalty_goals(2);
+				ss.set_time_taken(4417000000ULL);
+				ss.mutable_last_card()->set_team(SaveState::TEAM_BLUE);
+				ss.mutable_last_card()->set_card(SaveState::CARD_RED);
+				break;
+		}
+		return ss;
+	}
+
+	// The timings of one benchmark, one sample per batch of operations, and any further figures it reports.
+	struct Result {
+		std::string benchmark, fixture;
+		uint64_t operations;
+		std::vector<double> samples;
+		std::vector<std::pair<std::string, double>> figures;
+
+		Result(const std::string &benchmark, const std::string &fixture) : benchmark(benchmark), fixture(fixture), operations(0) {
+		}
+	};
+
+	// Writes a result as one line of JSON, with times in nanoseconds per operation.
+	void report(const Options &options, Result &result) {
+		std::ostream &out = *options.results;
+		std::vector<double> &samples = result.samples;
+		std::sort(samples.begin(), samples.end());
+		double total = 0.0;
+		for (double sample : samples) {
+			total += sample;
+		}
+		auto percentile = [&samples](double p) {
+			return samples.empty() ? 0.0 : samples[std::min(samples.size() - 1, static_cast<std::size_t>(p * static_cast<double>(samples.size())))];
+		};
+		out << "{\"benchmark\":\"" << result.benchmark << '"';
+		if (!result.fixture.empty()) {
+			out << ",\"fixture\":\"" << result.fixture << '"';
+		}
+		out << ",\"operations\":" << result.operations;
+		out << ",\"mean_ns\":" << (samples.empty() ? 0.0 : total / static_cast<double>(samples.size()));
+		out << ",\"p50_ns\":" << percentile(0.5);
+		out << ",\"p99_ns\":" << percentile(0.99);
+		out << ",\"max_ns\":" << (samples.empty() ? 0.0 : samples.back());
+		for (const std::pair<std::string, double> &figure : result.figures) {
+			out << ",\"" << figure.first << "\":" << figure.second;
+		}
+		out << "}\n" << std::flush;
+	}
+
+	double nanoseconds(std::chrono::steady_clock::duration d) {
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	}
+
+	// Runs an operation in timed batches after one untimed batch to warm up, recording the mean time per operation in each batch.
+	// Returns how many heap allocations each operation made, on average, on any thread.
+	template<typename Op> double measure(Result &result, unsigned int batches, unsigned int batch_size, Op op) {
+		for (unsigned int i = 0; i < batch_size; ++i) {
+			op();
+		}
+		uint64_t allocations = 0;
+		for (unsigned int batch = 0; batch < batches; ++batch) {
+			uint64_t before = allocation_count.load(std::memory_order_relaxed);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < batch_size; ++i) {
+				op();
+			}
+			std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+			allocations += allocation_count.load(std::memory_order_relaxed) - before;
+			result.samples.push_back(nanoseconds(elapsed) / batch_size);
+		}
+		uint64_t operations = static_cast<uint64_t>(batches) * batch_size;
+		result.operations += operations;
+		return static_cast<double>(allocations) / static_cast<double>(operations);
+	}
+
+	unsigned int scaled(const Options &options, unsigned int count) {
+		return std::max(1U, static_cast<unsigned int>(count * options.scale + 0.5));
+	}
+
+	bool wanted(const Options &options, const std::string &benchmark) {
+		return options.filter.empty() || benchmark.find(options.filter.raw()) != std::string::npos;
+	}
+
+	// The cost of deciding which character a legacy packet announces, mostly repeating the last one as during play, with a change every sixteenth packet.
+	void bench_compute_command(Logger &logger, const Configuration &configuration, const Options &options) {
+		if (!wanted(options, "legacy_compute_command")) {
+			return;
+		}
+		UDPTransmitter transmitter(logger, configuration.interface);
+		for (Fixture fixture : ALL_FIXTURES) {
+			LegacyPublisher publisher(configuration, transmitter);
+			SSL_Referee states[2];
+			states[0] = make_fixture(fixture, configuration).referee();
+			states[1] = states[0];
+			states[1].set_command(SSL_Referee::STOP);
+			unsigned int i = 0;
+			volatile char sink;
+			Result result("legacy_compute_command", fixture_name(fixture));
+			double allocations = measure(result, scaled(options, 200), 10000, [&]() {
+				sink = publisher.compute_command(states[(++i & 15) == 0]);
+			});
+			result.figures.emplace_back("allocations_per_op", allocations);
+			report(options, result);
+		}
+	}
+
+	// The cost of publishing one packet and sending it, as the controller does on every publish, with the state changed or unchanged since the last one.
+	void bench_publish(Logger &logger, const Configuration &configuration, const Options &options) {
+		struct Case {
+			const char *benchmark;
+			bool protobuf;
+			unsigned int changes;
+		};
+		static const Case CASES[] = {
+			{"protobuf_publish_changed", true, Publisher::CHANGE_ALL},
+			{"protobuf_publish_unchanged", true, 0},
+			{"legacy_publish", false, Publisher::CHANGE_CLOCKS},
+		};
+		for (const Case &c : CASES) {
+			if (!wanted(options, c.benchmark)) {
+				continue;
+			}
+			for (Fixture fixture : ALL_FIXTURES) {
+				UDPTransmitter transmitter(logger, configuration.interface);
+				std::unique_ptr<Publisher> publisher;
+				if (c.protobuf) {
+					publisher.reset(new ProtobufPublisher(configuration, transmitter));
+				} else {
+					publisher.reset(new LegacyPublisher(configuration, transmitter));
+				}
+				SaveState state = make_fixture(fixture, configuration);
+				uint64_t timestamp = state.referee().packet_timestamp();
+				Result result(c.benchmark, fixture_name(fixture));
+				const unsigned int batch_size = 100;
+				uint64_t syscalls_before = transmitter.system_calls();
+				double allocations = measure(result, scaled(options, 200), batch_size, [&]() {
+					timestamp += 25000;
+					state.mutable_referee()->set_packet_timestamp(timestamp);
+					publisher->publish(state, c.changes);
+					transmitter.flush();
+				});
+				// The warm-up batch sends too.
+				uint64_t sends = result.operations + batch_size;
+				result.figures.emplace_back("allocations_per_op", allocations);
+				result.figures.emplace_back("syscalls_per_op", static_cast<double>(transmitter.system_calls() - syscalls_before) / static_cast<double>(sends));
+				report(options, result);
+			}
+		}
+	}
+
+	// Writes a fixture to a game journal, for an engine to resume from.
+	void write_journal(const std::string &filename, const SaveState &state) {
+		std::remove(filename.c_str());
+		SaveWriter writer(filename, SystemClock::instance(), false);
+		writer.submit(state, SaveJournalRecord::OTHER);
+		writer.flush();
+	}
+
+	// The cost of one tick of the game clocks, including the publishes and saves that fall due, run in virtual time so nothing else competes for the lock.
+	void bench_tick(Logger &logger, const Configuration &base_configuration, const Options &options) {
+		if (!wanted(options, "tick")) {
+			return;
+		}
+		Configuration configuration(base_configuration);
+		configuration.save_filename = Glib::build_filename(options.scratch, "refbox-bench-tick.journal");
+		const std::string resume_filename = Glib::build_filename(options.scratch, "refbox-bench-resume.journal");
+		const std::chrono::microseconds tick_period(1000000 / configuration.tick_rate);
+		for (Fixture fixture : ALL_FIXTURES) {
+			write_journal(resume_filename, make_fixture(fixture, configuration));
+			std::remove(configuration.save_filename.c_str());
+			Result result("tick", fixture_name(fixture));
+			{
+				VirtualClock clock(std::chrono::microseconds(1500000000000000LL));
+				Engine engine(logger, configuration, resume_filename, clock);
+				GameController &controller = engine.controller();
+
+				// Resuming halts the game; get the clocks running again where the stage allows it.
+				for (SSL_Referee::Command command : {SSL_Referee::STOP, SSL_Referee::FORCE_START}) {
+					if (controller.can_set_command(command)) {
+						controller.set_command(command);
+					}
+				}
+				double allocations = measure(result, scaled(options, 200), 100, [&]() {
+					controller.advance_time(tick_period);
+				});
+				result.figures.emplace_back("allocations_per_op", allocations);
+				result.figures.emplace_back("tick_rate", configuration.tick_rate);
+			}
+			report(options, result);
+		}
+		std::remove(resume_filename.c_str());
+		std::remove(configuration.save_filename.c_str());
+	}
+
+	// The cost of saving the state: what the caller pays to queue a change, and how long until a change is safely on disk.
+	void bench_save(Logger &, const Configuration &configuration, const Options &options) {
+		const std::string filename = Glib::build_filename(options.scratch, "refbox-bench-save.journal");
+		for (Fixture fixture : ALL_FIXTURES) {
+			SaveState state = make_fixture(fixture, configuration);
+			if (wanted(options, "save_submit")) {
+				std::remove(filename.c_str());
+				SaveWriter writer(filename, SystemClock::instance(), false);
+				Result result("save_submit", fixture_name(fixture));
+				// Submit in bursts shorter than the writer’s queue, waiting for the disk between bursts without timing it.
+				const unsigned int batches = scaled(options, 100), batch_size = 32;
+				uint64_t allocations = 0;
+				for (unsigned int batch = 0; batch < batches; ++batch) {
+					uint64_t before = allocation_count.load(std::memory_order_relaxed);
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					for (unsigned int i = 0; i < batch_size; ++i) {
+						state.mutable_referee()->set_command_counter(state.referee().command_counter() + 1);
+						writer.submit(state, SaveJournalRecord::COMMAND);
+					}
+					std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+					allocations += allocation_count.load(std::memory_order_relaxed) - before;
+					result.samples.push_back(nanoseconds(elapsed) / batch_size);
+					writer.flush();
+				}
+				result.operations = static_cast<uint64_t>(batches) * batch_size;
+				result.figures.emplace_back("allocations_per_op", static_cast<double>(allocations) / static_cast<double>(result.operations));
+				report(options, result);
+			}
+			if (wanted(options, "save_durable")) {
+				std::remove(filename.c_str());
+				SaveWriter writer(filename, SystemClock::instance(), false);
+				Result result("save_durable", fixture_name(fixture));
+				measure(result, scaled(options, 100), 1, [&]() {
+					state.mutable_referee()->set_command_counter(state.referee().command_counter() + 1);
+					writer.submit(state, SaveJournalRecord::COMMAND);
+					writer.flush();
+				});
+				report(options, result);
+			}
+		}
+		std::remove(filename.c_str());
+	}
+
+#ifndef WIN32
+	void send_fully(int fd, const std::string &data) {
+		std::size_t sent = 0;
+		while (sent < data.size()) {
+			ssize_t rc = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+			if (rc < 0) {
+				throw SystemError("Cannot send remote control request");
+			}
+			sent += static_cast<std::size_t>(rc);
+		}
+	}
+
+	void receive_fully(int fd, void *buffer, std::size_t length) {
+		std::size_t received = 0;
+		while (received < length) {
+			ssize_t rc = recv(fd, static_cast<char *>(buffer) + received, length - received, 0);
+			if (rc < 0) {
+				throw SystemError("Cannot receive remote control reply");
+			} else if (!rc) {
+				throw std::runtime_error("Remote control server closed the connection");
+			}
+			received += static_cast<std::size_t>(rc);
+		}
+	}
+
+	// One remote control client: sends bursts of requests, pipelined, and records the time from sending each burst to receiving each reply.
+	// With commands set, the requests alternate between STOP and FORCE_START, each naming the command counter it expects, starting from the given one; otherwise they are no-ops.
+	void run_client(uint16_t port, unsigned int rounds, unsigned int burst, bool commands, uint32_t command_counter, std::vector<double> &samples) {
+		Descriptor sock(socket(AF_INET, SOCK_STREAM, 0), "Cannot create remote control client socket");
+		timeval timeout{10, 0};
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (connect(sock, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0) {
+			throw SystemError("Cannot connect to remote control server");
+		}
+
+		SSL_RefereeRemoteControlRequest request;
+		SSL_RefereeRemoteControlReply reply;
+		std::string frames, body;
+		for (unsigned int round = 0; round < rounds; ++round) {
+			frames.clear();
+			for (unsigned int i = 0; i < burst; ++i) {
+				const uint32_t id = round * burst + i;
+				request.set_message_id(id);
+				if (commands) {
+					request.set_command(id % 2 ? SSL_Referee::FORCE_START : SSL_Referee::STOP);
+					request.set_last_command_counter(command_counter + id);
+				}
+				request.SerializeToString(&body);
+				uint32_t length = htonl(static_cast<uint32_t>(body.size()));
+				frames.append(reinterpret_cast<const char *>(&length), sizeof(length));
+				frames += body;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			send_fully(sock, frames);
+			for (unsigned int i = 0; i < burst; ++i) {
+				uint32_t length;
+				receive_fully(sock, &length, sizeof(length));
+				body.resize(ntohl(length));
+				receive_fully(sock, &body[0], body.size());
+				samples.push_back(nanoseconds(std::chrono::steady_clock::now() - start));
+				if (!reply.ParseFromString(body) || reply.message_id() != round * burst + i || reply.outcome() != SSL_RefereeRemoteControlReply::OK) {
+					throw std::runtime_error("Unexpected remote control reply");
+				}
+			}
+		}
+	}
+
+	// The round trip of remote control requests through a running referee box, served on the main loop or on a dedicated thread, from one client or many at once.
+	// The command cases carry out a real command with every request, so they include the state change, publish, and journal write that follow.
+	void bench_rcon(Logger &logger, const Configuration &base_configuration, const Options &options) {
+		struct Case {
+			const char *benchmark;
+			bool thread;
+			bool stress;
+			bool commands;
+		};
+		static const Case CASES[] = {
+			{"rcon_round_trip", false, false, false},
+			{"rcon_command_round_trip", false, false, true},
+			{"rcon_stress", false, true, false},
+			{"rcon_thread_round_trip", true, false, false},
+			{"rcon_thread_command_round_trip", true, false, true},
+			{"rcon_thread_stress", true, true, false},
+		};
+		for (const Case &c : CASES) {
+			if (!wanted(options, c.benchmark)) {
+				continue;
+			}
+#ifndef __linux__
+			if (c.thread) {
+				continue;
+			}
+#endif
+			const unsigned int clients = c.stress ? static_cast<unsigned int>(std::max(1, options.clients)) : 1U;
+			const unsigned int burst = c.stress ? 8U : 1U;
+			const unsigned int rounds = c.stress ? scaled(options, 200) : scaled(options, 2000);
+
+			Configuration configuration(base_configuration);
+			configuration.save_filename = Glib::build_filename(options.scratch, "refbox-bench-rcon.journal");
+			const std::string resume_filename = Glib::build_filename(options.scratch, "refbox-bench-rcon-resume.journal");
+			configuration.rcon_thread = c.thread;
+			configuration.rcon_max_connections = std::max(configuration.rcon_max_connections, clients);
+			if (!configuration.rcon_port) {
+				configuration.rcon_port = 10007;
+			}
+			std::remove(configuration.save_filename.c_str());
+
+			// Commands need a game in progress; resuming it halts it, and the first STOP starts the alternation from there.
+			if (c.commands) {
+				write_journal(resume_filename, make_fixture(Fixture::SECOND_HALF, configuration));
+			}
+
+			Result result(c.benchmark, c.commands ? fixture_name(Fixture::SECOND_HALF) : "");
+			{
+				Engine engine(logger, configuration, c.commands ? resume_filename : "");
+				RConServer server(engine.controller());
+				uint32_t command_counter;
+				{
+					std::lock_guard<std::recursive_mutex> lock(engine.controller().mutex);
+					command_counter = engine.controller().state.referee().command_counter();
+				}
+
+				// Run the clients on their own threads while this one runs the main loop, which the server and controller need.
+				std::vector<std::vector<double>> samples(clients);
+				std::vector<std::exception_ptr> errors(clients);
+				std::atomic<unsigned int> remaining(clients);
+				Glib::Dispatcher finished;
+				std::vector<std::thread> threads;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (unsigned int i = 0; i < clients; ++i) {
+					threads.emplace_back([&, i]() {
+						try {
+							run_client(configuration.rcon_port, rounds, burst, c.commands, command_counter, samples[i]);
+						} catch (...) {
+							errors[i] = std::current_exception();
+						}
+						--remaining;
+						finished.emit();
+					});
+				}
+				Glib::RefPtr<Glib::MainContext> context = Glib::MainContext::get_default();
+				while (remaining) {
+					context->iteration(true);
+				}
+				std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+				for (std::thread &thread : threads) {
+					thread.join();
+				}
+				for (const std::exception_ptr &error : errors) {
+					if (error) {
+						std::rethrow_exception(error);
+					}
+				}
+
+				for (const std::vector<double> &client_samples : samples) {
+					result.samples.insert(result.samples.end(), client_samples.begin(), client_samples.end());
+				}
+				result.operations = result.samples.size();
+				result.figures.emplace_back("clients", clients);
+				result.figures.emplace_back("burst", burst);
+				result.figures.emplace_back("requests_per_second", static_cast<double>(result.operations) / (nanoseconds(elapsed) / 1.0e9));
+			}
+			report(options, result);
+			std::remove(resume_filename.c_str());
+			std::remove(configuration.save_filename.c_str());
+		}
+	}
+#endif
+
+	int main_impl(int argc, char **argv) {
+		// Set the current locale.
+		std::locale::global(std::locale(""));
+
+		// Initialize Glib and Gio; the remote control benchmarks need a main loop.
+		Gio::init();
+
+		// Parse the command-line arguments.
+		Glib::OptionContext option_context;
+		option_context.set_summary(u8"Measures the cost of the Referee Box’s hot paths against fixed game states, writing one line of JSON per result to a file.");
+		option_context.set_description(u8"The Referee Box is © RoboCup Federation, 2003–2013.");
+
+		Glib::OptionGroup option_group(u8"bench", u8"Benchmark Options", u8"Show Benchmark Options");
+
+		Glib::OptionEntry config_file_entry;
+		config_file_entry.set_long_name(u8"config");
+		config_file_entry.set_short_name('C');
+		config_file_entry.set_description(u8"Sets the name of the configuration file whose timings, addresses, and ports are used (defaults to referee.conf).");
+		config_file_entry.set_arg_description(u8"CONFIGFILE");
+		std::string config_filename("referee.conf");
+		option_group.add_entry_filename(config_file_entry, config_filename);
+
+		Options options;
+		options.scale = 1.0;
+		options.clients = 32;
+		options.scratch = Glib::get_tmp_dir();
+
+		Glib::OptionEntry filter_entry;
+		filter_entry.set_long_name(u8"filter");
+		filter_entry.set_short_name('f');
+		filter_entry.set_description(u8"Runs only the benchmarks whose names contain a string.");
+		filter_entry.set_arg_description(u8"STRING");
+		option_group.add_entry(filter_entry, options.filter);
+
+		Glib::OptionEntry scale_entry;
+		scale_entry.set_long_name(u8"scale");
+		scale_entry.set_short_name('s');
+		scale_entry.set_description(u8"Multiplies the number of operations each benchmark runs (defaults to 1).");
+		scale_entry.set_arg_description(u8"FACTOR");
+		option_group.add_entry(scale_entry, options.scale);
+
+		Glib::OptionEntry clients_entry;
+		clients_entry.set_long_name(u8"clients");
+		clients_entry.set_description(u8"Sets the number of remote control clients in the stress benchmarks (defaults to 32).");
+		clients_entry.set_arg_description(u8"COUNT");
+		option_group.add_entry(clients_entry, options.clients);
+
+		Glib::OptionEntry scratch_entry;
+		scratch_entry.set_long_name(u8"scratch");
+		scratch_entry.set_description(u8"Sets the directory in which to write game journals (defaults to the temporary directory).");
+		scratch_entry.set_arg_description(u8"DIRECTORY");
+		option_group.add_entry_filename(scratch_entry, options.scratch);
+
+		Glib::OptionEntry output_entry;
+		output_entry.set_long_name(u8"output");
+		output_entry.set_short_name('o');
+		output_entry.set_description(u8"Sets the name of the file to write results to, one JSON object per line (defaults to refbox_bench.jsonl).");
+		output_entry.set_arg_description(u8"FILE");
+		std::string output_filename("refbox_bench.jsonl");
+		option_group.add_entry_filename(output_entry, output_filename);
+
+		option_context.set_main_group(option_group);
+		option_context.parse(argc, argv);
+		if (!(options.scale > 0.0)) {
+			throw std::runtime_error("The scale must be positive.");
+		}
+
+		// Keep numbers in the results machine-readable whatever the locale.
+		std::ofstream results;
+		results.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+		results.open(output_filename, std::ios_base::out | std::ios_base::trunc);
+		results.imbue(std::locale::classic());
+		options.results = &results;
+
+		// Record no events, whatever the configuration file says.
+		Configuration configuration(config_filename);
+		configuration.event_log_filename.clear();
+		Logger logger("", std::chrono::milliseconds(configuration.log_flush_interval_milliseconds));
+
+		bench_compute_command(logger, configuration, options);
+		bench_publish(logger, configuration, options);
+		bench_tick(logger, configuration, options);
+		bench_save(logger, configuration, options);
+#ifndef WIN32
+		bench_rcon(logger, configuration, options);
+#endif
+
+		// Shut down protobuf.
+		google::protobuf::ShutdownProtobufLibrary();
+
+		return 0;
+	}
+
+	void print_exception(const Glib::Exception &exp) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+	}
+
+	void print_exception(const std::exception &exp, bool first = true) {
+		if (first) {
+			std::cerr << "\nUnhandled exception:\n";
+		} else {
+			std::cerr << "Caused by:\n";
+		}
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+		try {
+			std::rethrow_if_nested(exp);
+		} catch (const std::exception &exp) {
+			print_exception(exp, false);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	try {
+		return main_impl(argc, argv);
+	} catch (const Glib::Exception &exp) {
+		print_exception(exp);
+	} catch (const std::exception &exp) {
+		print_exception(exp);
+	} catch (...) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   Unknown\n";
+		std::cerr << "Detail: Unknown\n";
+	}
+	return 1;
+}
@@ -26,11 +26,14 @@ Configuration::Configuration(const std::string &filename) {
 	yellow_card_seconds = static_cast<unsigned int>(kf.get_integer(u8"global", u8"YELLOW_CARD_TIME"));
 	team_names_required = kf.get_boolean(u8"global", u8"TEAM_NAMES_REQUIRED");
 	rcon_enabled_by_default = kf.get_boolean(u8"global", u8"RCON_ENABLED_BY_DEFAULT");
+	tick_rate = kf.has_key(u8"global", u8"TICK_RATE") ? static_cast<unsigned int>(std::max(1, kf.get_integer(u8"global", u8"TICK_RATE"))) : 40;
 
 	if (kf.has_key(u8"files", u8"SAVE")) {
 		save_filename = Glib::filename_from_utf8(Glib::ustring::compose(kf.get_string(u8"files", u8"SAVE"), Glib::DateTime::create_now_local().format(u8"%Y%m%dT%H%M%S")));
 	}
 	log_filename = kf.has_key(u8"files", u8"LOG") ? Glib::filename_from_utf8(kf.get_string(u8"files", u8"LOG")) : "";
+	event_log_filename = kf.has_key(u8"files", u8"EVENT_LOG") ? Glib::filename_from_utf8(kf.get_string(u8"files", u8"EVENT_LOG")) : "";
+	log_flush_interval_milliseconds = kf.has_key(u8"files", u8"LOG_FLUSH_INTERVAL") ? static_cast<unsigned int>(std::max(1, kf.get_integer(u8"files", u8"LOG_FLUSH_INTERVAL"))) : 250;
 
 	address = kf.get_string(u8"ip", u8"ADDRESS");
 	legacy_port = kf.has_key(u8"ip", u8"LEGACY_PORT") ? kf.get_string(u8"ip", u8"LEGACY_PORT") : "";
@@ -41,6 +44,10 @@ Configuration::Configuration(const std::string &filename) {
 	} else {
 		rcon_port = 0;
 	}
+	rcon_thread = kf.has_key(u8"ip", u8"RCON_THREAD") && kf.get_boolean(u8"ip", u8"RCON_THREAD");
+	rcon_max_connections = kf.has_key(u8"ip", u8"RCON_MAX_CONNECTIONS") ? static_cast<unsigned int>(std::max(1, kf.get_integer(u8"ip", u8"RCON_MAX_CONNECTIONS"))) : 16;
+	rcon_output_budget = kf.has_key(u8"ip", u8"RCON_OUTPUT_BUDGET") ? static_cast<std::size_t>(std::max(4096, kf.get_integer(u8"ip", u8"RCON_OUTPUT_BUDGET"))) : 65536;
+	publish_interval_milliseconds = kf.has_key(u8"ip", u8"PUBLISH_INTERVAL") ? static_cast<unsigned int>(std::max(1, kf.get_integer(u8"ip", u8"PUBLISH_INTERVAL"))) : 25;
 
 	for (const Glib::ustring &key : kf.get_keys(u8"teams")) {
 		teams.push_back(kf.get_string(u8"teams", key));
@@ -58,12 +65,17 @@ void Configuration::dump(Logger &logger) {
 	logger.write(Glib::ustring::compose(u8"Configuration: Overtime timeouts: %1, totalling up to %2 seconds.", overtime_timeouts, overtime_timeout_seconds));
 	logger.write(Glib::ustring::compose(u8"Configuration: Pre-shootout break: %1 seconds.", shootout_break_seconds));
 	logger.write(Glib::ustring::compose(u8"Configuration: Yellow card: %1 seconds.", yellow_card_seconds));
+	logger.write(Glib::ustring::compose(u8"Configuration: Tick rate: %1 per second.", tick_rate));
 	if (!save_filename.empty()) {
 		logger.write(Glib::ustring::compose(u8"Configuration: State save filename: \"%1\".", Glib::filename_to_utf8(save_filename)));
 	}
 	if (!log_filename.empty()) {
 		logger.write(Glib::ustring::compose(u8"Configuration: Log filename: \"%1\".", Glib::filename_to_utf8(log_filename)));
 	}
+	if (!event_log_filename.empty()) {
+		logger.write(Glib::ustring::compose(u8"Configuration: Event log filename: \"%1\".", Glib::filename_to_utf8(event_log_filename)));
+	}
+	logger.write(Glib::ustring::compose(u8"Configuration: Log flush interval: %1 milliseconds.", log_flush_interval_milliseconds));
 	logger.write(Glib::ustring::compose(u8"Configuration: Packet destination address: \"%1\".", Glib::locale_to_utf8(address)));
 	if (!legacy_port.empty()) {
 		logger.write(Glib::ustring::compose(u8"Configuration: Legacy port: \"%1\".", legacy_port));
@@ -71,8 +83,10 @@ void Configuration::dump(Logger &logger) {
 	if (!protobuf_port.empty()) {
 		logger.write(Glib::ustring::compose(u8"Configuration: Protobuf port: \"%1\".", protobuf_port));
 	}
+	logger.write(Glib::ustring::compose(u8"Configuration: Publish interval: %1 milliseconds.", publish_interval_milliseconds));
 	if (rcon_port) {
-		logger.write(Glib::ustring::compose(u8"Configuration: Remote control port: %1.", rcon_port));
+		logger.write(Glib::ustring::compose(u8"Configuration: Remote control port: %1%2.", rcon_port, rcon_thread ? u8", served on its own thread" : u8""));
+		logger.write(Glib::ustring::compose(u8"Configuration: Remote control: up to %1 connections, %2 bytes of output each.", rcon_max_connections, rcon_output_budget));
 	}
 	if (!interface.empty()) {
 		logger.write(Glib::ustring::compose(u8"Configuration: Network interface: \"%1\".", Glib::locale_to_utf8(interface)));
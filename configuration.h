@@ -1,6 +1,7 @@
 #ifndef CONFIGURATION_H
 #define CONFIGURATION_H
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -30,10 +31,13 @@ class Configuration {
 		unsigned int yellow_card_seconds;
 		bool team_names_required;
 		bool rcon_enabled_by_default;
+		unsigned int tick_rate;
 
 		// [files] section
 		std::string save_filename;
 		std::string log_filename;
+		std::string event_log_filename;
+		unsigned int log_flush_interval_milliseconds;
 
 		// [ip] section
 		std::string address;
@@ -41,6 +45,10 @@ class Configuration {
 		std::string protobuf_port;
 		std::string interface;
 		uint16_t rcon_port;
+		bool rcon_thread;
+		unsigned int rcon_max_connections;
+		std::size_t rcon_output_budget;
+		unsigned int publish_interval_milliseconds;
 
 		// [teams] section
 		std::vector<Glib::ustring> teams;
@@ -0,0 +1,31 @@
+#include "descriptor.h"
+#include "exception.h"
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+Descriptor::Descriptor(int fd, const std::string &message) : fd(fd) {
+	if (fd < 0) {
+		throw SystemError(message);
+	}
+}
+
+Descriptor::~Descriptor() {
+#ifndef WIN32
+	if (fd >= 0) {
+		close(fd);
+	}
+#endif
+}
+
+Descriptor &Descriptor::operator=(Descriptor &&moveref) {
+#ifndef WIN32
+	if (fd >= 0 && fd != moveref.fd) {
+		close(fd);
+	}
+#endif
+	fd = moveref.fd;
+	moveref.fd = -1;
+	return *this;
+}
@@ -0,0 +1,31 @@
+#ifndef DESCRIPTOR_H
+#define DESCRIPTOR_H
+
+#include "noncopyable.h"
+#include <string>
+
+// Owns a POSIX file descriptor, such as a timer, event, or epoll descriptor, and closes it on destruction.
+class Descriptor : public NonCopyable {
+	public:
+		// Takes ownership of fd, throwing a SystemError built from message and errno if fd is negative.
+		Descriptor(int fd, const std::string &message);
+		Descriptor(Descriptor &&moveref);
+		~Descriptor();
+		Descriptor &operator=(Descriptor &&moveref);
+		operator int() const;
+
+	private:
+		int fd;
+};
+
+
+
+inline Descriptor::Descriptor(Descriptor &&moveref) : fd(moveref.fd) {
+	moveref.fd = -1;
+}
+
+inline Descriptor::operator int() const {
+	return fd;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#include "engine.h"
+#include "configuration.h"
+
+Engine::Engine(Logger &logger, const Configuration &configuration, const std::string &resume_filename, Clock &clock) :
+		transmitter(logger, configuration.interface),
+		protobuf_publisher(configuration.protobuf_port.empty() ? nullptr : new ProtobufPublisher(configuration, transmitter)),
+		legacy_publisher(configuration.legacy_port.empty() ? nullptr : new LegacyPublisher(configuration, transmitter)),
+		publishers(collect_publishers()),
+		controller_(logger, configuration, publishers, transmitter, clock, resume_filename) {
+}
+
+GameController &Engine::controller() {
+	return controller_;
+}
+
+std::vector<Publisher *> Engine::collect_publishers() const {
+	std::vector<Publisher *> result;
+	if (protobuf_publisher) {
+		result.push_back(protobuf_publisher.get());
+	}
+	if (legacy_publisher) {
+		result.push_back(legacy_publisher.get());
+	}
+	return result;
+}
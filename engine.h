@@ -0,0 +1,36 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "gamecontroller.h"
+#include "legacypublisher.h"
+#include "noncopyable.h"
+#include "protobufpublisher.h"
+#include "timing.h"
+#include "udpbroadcast.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class Configuration;
+class Logger;
+class Publisher;
+
+// Everything needed to referee a game, independent of any user interface: the game controller with its clocks and persistence, and the publishers with the transmitter they share.
+// The clocks run on their own thread; change signals and the remote control server need a Glib main loop running on the constructing thread.
+class Engine : public NonCopyable {
+	public:
+		// Passing a VirtualClock runs the game in virtual time, advanced only through GameController::advance_time.
+		Engine(Logger &logger, const Configuration &configuration, const std::string &resume_filename, Clock &clock = SystemClock::instance());
+		GameController &controller();
+
+	private:
+		UDPTransmitter transmitter;
+		std::unique_ptr<ProtobufPublisher> protobuf_publisher;
+		std::unique_ptr<LegacyPublisher> legacy_publisher;
+		std::vector<Publisher *> publishers;
+		GameController controller_;
+
+		std::vector<Publisher *> collect_publishers() const;
+};
+
+#endif
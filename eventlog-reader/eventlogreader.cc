@@ -0,0 +1,472 @@
+#include "eventlog.pb.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <google/protobuf/io/coded_stream.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace {
+	const char EVENT_LOG_MAGIC[4] = {'S', 'S', 'L', 'E'};
+
+	// Records are written with their fields in order, so a record’s kind is the number of the field after the timestamp.
+	enum Kind {
+		KIND_NONE = 0,
+		KIND_DROPPED = EventLogRecord::kDroppedFieldNumber,
+		KIND_START = EventLogRecord::kStartFieldNumber,
+		KIND_PUBLISH = EventLogRecord::kPublishFieldNumber,
+		KIND_TRANSITION = EventLogRecord::kTransitionFieldNumber,
+		KIND_REMOTE_CONTROL = EventLogRecord::kRemoteControlFieldNumber,
+	};
+
+	struct KindName {
+		Kind kind;
+		const char *name;
+	};
+
+	const KindName KIND_NAMES[] = {
+		{ KIND_START, "start" },
+		{ KIND_PUBLISH, "publish" },
+		{ KIND_TRANSITION, "transition" },
+		{ KIND_REMOTE_CONTROL, "rcon" },
+		{ KIND_DROPPED, "dropped" },
+	};
+
+	// The Publisher::Change bits of interest here.
+	const uint32_t CHANGE_CLOCKS = 1 << 0;
+	const uint32_t CHANGE_COMMAND = 1 << 1;
+	const uint32_t CHANGE_STAGE = 1 << 2;
+
+	void usage(const char *app_name) {
+		std::cerr << "Usage:\n" << app_name << " [--stats] [--kind KIND]... [--from SECONDS] [--to SECONDS] EVENTLOG...\n"
+			"Prints the records of referee box event logs, or with --stats, statistics over them.\n"
+			"KIND is one of start, publish, transition, rcon, or dropped; SECONDS count from the start of each run.\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	// The contents of a file, mapped into memory where possible so even a large log is read at the speed of the page cache.
+	class FileData {
+		public:
+			explicit FileData(const char *filename);
+			~FileData();
+			const char *data() const;
+			std::size_t size() const;
+
+		private:
+#ifndef WIN32
+			void *map;
+			std::size_t length;
+#else
+			std::string contents;
+#endif
+	};
+
+	FileData::FileData(const char *filename) {
+#ifndef WIN32
+		map = nullptr;
+		length = 0;
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			std::cerr << filename << ": " << std::strerror(errno) << '\n';
+			std::exit(EXIT_FAILURE);
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			std::cerr << filename << ": " << std::strerror(errno) << '\n';
+			std::exit(EXIT_FAILURE);
+		}
+		length = static_cast<std::size_t>(st.st_size);
+		if (length) {
+			map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map == MAP_FAILED) {
+				std::cerr << filename << ": " << std::strerror(errno) << '\n';
+				std::exit(EXIT_FAILURE);
+			}
+			// The file is read once from front to back.
+			madvise(map, length, MADV_SEQUENTIAL);
+		}
+		close(fd);
+#else
+		std::ifstream ifs(filename, std::ios_base::in | std::ios_base::binary);
+		if (!ifs) {
+			std::cerr << filename << ": cannot open\n";
+			std::exit(EXIT_FAILURE);
+		}
+		contents.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+#endif
+	}
+
+	FileData::~FileData() {
+#ifndef WIN32
+		if (map) {
+			munmap(map, length);
+		}
+#endif
+	}
+
+	const char *FileData::data() const {
+#ifndef WIN32
+		return static_cast<const char *>(map);
+#else
+		return contents.data();
+#endif
+	}
+
+	std::size_t FileData::size() const {
+#ifndef WIN32
+		return length;
+#else
+		return contents.size();
+#endif
+	}
+
+	uint32_t read_uint32_be(const char *data) {
+		const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+		return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+	}
+
+	// The parts of a record needed to filter it and to gather most statistics, read without a full parse.
+	struct Header {
+		uint64_t timestamp;
+		Kind kind;
+		// The bytes of the record’s one optional field, if it is a message, or its value, if not.
+		const uint8_t *body;
+		int body_length;
+		uint64_t value;
+	};
+
+	bool read_header(const uint8_t *data, int length, Header &header) {
+		google::protobuf::io::CodedInputStream in(data, length);
+		if (in.ReadTag() != ((EventLogRecord::kTimestampFieldNumber << 3) | 0) || !in.ReadVarint64(&header.timestamp)) {
+			return false;
+		}
+		uint32_t tag = in.ReadTag();
+		header.kind = static_cast<Kind>(tag >> 3);
+		header.body = nullptr;
+		header.body_length = 0;
+		header.value = 0;
+		if ((tag & 7) == 0) {
+			return in.ReadVarint64(&header.value);
+		} else if ((tag & 7) == 2) {
+			uint32_t size;
+			if (!in.ReadVarint32(&size) || static_cast<int>(size) > length - in.CurrentPosition()) {
+				return false;
+			}
+			header.body = data + in.CurrentPosition();
+			header.body_length = static_cast<int>(size);
+			return true;
+		}
+		return false;
+	}
+
+	// Reads the changes and command counter of a publish without a full parse; these are the bulk of every log.
+	bool read_publish(const Header &header, uint32_t &changes, uint32_t &command_counter) {
+		google::protobuf::io::CodedInputStream in(header.body, header.body_length);
+		changes = 0;
+		command_counter = 0;
+		for (;;) {
+			uint32_t tag = in.ReadTag();
+			if (!tag) {
+				return true;
+			}
+			uint64_t value;
+			if ((tag & 7) != 0 || !in.ReadVarint64(&value)) {
+				return false;
+			}
+			if ((tag >> 3) == EventLogRecord::Publish::kChangesFieldNumber) {
+				changes = static_cast<uint32_t>(value);
+			} else if ((tag >> 3) == EventLogRecord::Publish::kCommandCounterFieldNumber) {
+				command_counter = static_cast<uint32_t>(value);
+			}
+		}
+	}
+
+	struct Options {
+		bool stats;
+		std::vector<Kind> kinds;
+		double from, to;
+	};
+
+	// A running minimum, mean, and maximum of a duration in microseconds.
+	struct Summary {
+		uint64_t count;
+		uint64_t total;
+		uint64_t min;
+		uint64_t max;
+
+		Summary() : count(0), total(0), min(UINT64_MAX), max(0) {
+		}
+
+		void add(uint64_t value) {
+			++count;
+			total += value;
+			min = std::min(min, value);
+			max = std::max(max, value);
+		}
+
+		void print(const char *label) const {
+			if (count) {
+				std::printf("%s: %" PRIu64 ", min %.3f ms, mean %.3f ms, max %.3f ms\n", label, count, static_cast<double>(min) / 1000.0, static_cast<double>(total) / static_cast<double>(count) / 1000.0, static_cast<double>(max) / 1000.0);
+			} else {
+				std::printf("%s: 0\n", label);
+			}
+		}
+	};
+
+	struct Statistics {
+		uint64_t runs;
+		uint64_t bytes;
+		std::map<Kind, uint64_t> records;
+		uint64_t dropped;
+		uint64_t malformed;
+		Summary publish_interval;
+		uint64_t periodic_publishes;
+		std::map<int, uint64_t> commands, stages, outcomes;
+		uint64_t held;
+		// From an accepted remote control request that changed the command until the first publish carrying the new command counter.
+		Summary command_latency;
+
+		// Parsed into over and over, so that their memory is reused rather than allocated for every record.
+		EventLogRecord::Transition transition;
+		EventLogRecord::RemoteControl remote_control;
+
+		Statistics() : runs(0), bytes(0), dropped(0), malformed(0), periodic_publishes(0), held(0) {
+		}
+	};
+
+	struct RunState {
+		uint64_t start;
+		bool have_publish;
+		uint64_t last_publish;
+		uint32_t last_counter;
+		// Remote control commands waiting for their first publish, as pairs of command counter and time.
+		std::vector<std::pair<uint32_t, uint64_t>> pending_commands;
+	};
+
+	const char *kind_name(Kind kind) {
+		for (const KindName &kn : KIND_NAMES) {
+			if (kn.kind == kind) {
+				return kn.name;
+			}
+		}
+		return "unknown";
+	}
+
+	void gather(const Header &header, RunState &run, Statistics &stats) {
+		++stats.records[header.kind];
+		switch (header.kind) {
+			case KIND_DROPPED:
+				stats.dropped += header.value;
+				break;
+
+			case KIND_PUBLISH: {
+				uint32_t changes, counter;
+				if (!read_publish(header, changes, counter)) {
+					++stats.malformed;
+					break;
+				}
+				if (run.have_publish) {
+					stats.publish_interval.add(header.timestamp - run.last_publish);
+				}
+				if (!(changes & ~CHANGE_CLOCKS)) {
+					++stats.periodic_publishes;
+				}
+				run.have_publish = true;
+				run.last_publish = header.timestamp;
+				run.last_counter = counter;
+				std::vector<std::pair<uint32_t, uint64_t>>::iterator kept = run.pending_commands.begin();
+				for (const std::pair<uint32_t, uint64_t> &pending : run.pending_commands) {
+					if (pending.first <= counter) {
+						stats.command_latency.add(header.timestamp - pending.second);
+					} else {
+						*kept++ = pending;
+					}
+				}
+				run.pending_commands.erase(kept, run.pending_commands.end());
+				break;
+			}
+
+			case KIND_TRANSITION: {
+				EventLogRecord::Transition &transition = stats.transition;
+				if (!transition.ParsePartialFromArray(header.body, header.body_length)) {
+					++stats.malformed;
+					break;
+				}
+				if (transition.changes() & CHANGE_COMMAND) {
+					++stats.commands[transition.referee().command()];
+				}
+				if (transition.changes() & CHANGE_STAGE) {
+					++stats.stages[transition.referee().stage()];
+				}
+				break;
+			}
+
+			case KIND_REMOTE_CONTROL: {
+				EventLogRecord::RemoteControl &rc = stats.remote_control;
+				if (!rc.ParsePartialFromArray(header.body, header.body_length)) {
+					++stats.malformed;
+					break;
+				}
+				if (rc.held()) {
+					++stats.held;
+					break;
+				}
+				++stats.outcomes[rc.outcome()];
+				if (rc.outcome() == SSL_RefereeRemoteControlReply::OK && (rc.request().has_command() || rc.request().has_stage() || rc.request().has_card())) {
+					// A change that went out urgently was published while the request ran, before its record was written.
+					if (run.have_publish && run.last_counter == rc.command_counter() && run.last_publish >= header.timestamp) {
+						stats.command_latency.add(run.last_publish - header.timestamp);
+					} else if (!run.have_publish || run.last_counter != rc.command_counter()) {
+						run.pending_commands.emplace_back(rc.command_counter(), header.timestamp);
+					}
+				}
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	void print_record(const Header &header, const RunState &run, const uint8_t *data, int length) {
+		EventLogRecord record;
+		if (!record.ParsePartialFromArray(data, length)) {
+			std::printf("[%.6f] malformed record\n", static_cast<double>(header.timestamp - run.start) / 1000000.0);
+			return;
+		}
+		record.clear_timestamp();
+		std::printf("[%.6f] %s %s\n", static_cast<double>(header.timestamp - run.start) / 1000000.0, kind_name(header.kind), record.ShortDebugString().c_str());
+	}
+
+	void process(const char *filename, const Options &options, Statistics &stats) {
+		FileData file(filename);
+		const char *data = file.data();
+		std::size_t size = file.size();
+		if (size < sizeof(EVENT_LOG_MAGIC) || !std::equal(EVENT_LOG_MAGIC, EVENT_LOG_MAGIC + sizeof(EVENT_LOG_MAGIC), data)) {
+			std::cerr << filename << ": not an event log\n";
+			std::exit(EXIT_FAILURE);
+		}
+		stats.bytes += size;
+
+		RunState run = RunState();
+		std::size_t pos = sizeof(EVENT_LOG_MAGIC);
+		while (size - pos >= 4) {
+			uint32_t length = read_uint32_be(data + pos);
+			pos += 4;
+			if (length > size - pos) {
+				// The last record was cut off by a crash.
+				break;
+			}
+			const uint8_t *record = reinterpret_cast<const uint8_t *>(data + pos);
+			pos += length;
+
+			Header header;
+			if (!read_header(record, static_cast<int>(length), header)) {
+				++stats.malformed;
+				continue;
+			}
+			if (header.kind == KIND_START) {
+				++stats.runs;
+				run = RunState();
+				run.start = header.timestamp;
+			}
+			if (!options.kinds.empty() && std::find(options.kinds.begin(), options.kinds.end(), header.kind) == options.kinds.end()) {
+				continue;
+			}
+			double seconds = static_cast<double>(header.timestamp - run.start) / 1000000.0;
+			if (seconds < options.from || seconds > options.to) {
+				continue;
+			}
+			if (options.stats) {
+				gather(header, run, stats);
+			} else {
+				print_record(header, run, record, static_cast<int>(length));
+			}
+		}
+	}
+
+	void print_counts(const char *label, const std::map<int, uint64_t> &counts, const google::protobuf::EnumDescriptor *descriptor) {
+		for (const std::pair<const int, uint64_t> &count : counts) {
+			const google::protobuf::EnumValueDescriptor *value = descriptor->FindValueByNumber(count.first);
+			std::printf("%s %s: %" PRIu64 "\n", label, value ? value->name().c_str() : "unknown", count.second);
+		}
+	}
+
+	void print_statistics(const Statistics &stats) {
+		std::printf("bytes: %" PRIu64 "\n", stats.bytes);
+		std::printf("runs: %" PRIu64 "\n", stats.runs);
+		for (const KindName &kn : KIND_NAMES) {
+			std::map<Kind, uint64_t>::const_iterator it = stats.records.find(kn.kind);
+			std::printf("records %s: %" PRIu64 "\n", kn.name, it == stats.records.end() ? 0 : it->second);
+		}
+		std::printf("records lost: %" PRIu64 "\n", stats.dropped);
+		std::printf("records malformed: %" PRIu64 "\n", stats.malformed);
+		std::printf("periodic publishes: %" PRIu64 "\n", stats.periodic_publishes);
+		stats.publish_interval.print("publish interval");
+		print_counts("command", stats.commands, SSL_Referee::Command_descriptor());
+		print_counts("stage", stats.stages, SSL_Referee::Stage_descriptor());
+		print_counts("rcon outcome", stats.outcomes, SSL_RefereeRemoteControlReply::Outcome_descriptor());
+		std::printf("rcon held: %" PRIu64 "\n", stats.held);
+		stats.command_latency.print("rcon command latency");
+	}
+}
+
+int main(int argc, char **argv) {
+	GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+	Options options;
+	options.stats = false;
+	options.from = 0.0;
+	options.to = 1.0e300;
+	std::vector<const char *> filenames;
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp(argv[i], "--stats")) {
+			options.stats = true;
+		} else if (!std::strcmp(argv[i], "--kind") && i + 1 < argc) {
+			const char *name = argv[++i];
+			const KindName *found = std::find_if(std::begin(KIND_NAMES), std::end(KIND_NAMES), [name](const KindName &kn) { return !std::strcmp(kn.name, name); });
+			if (found == std::end(KIND_NAMES)) {
+				usage(argv[0]);
+			}
+			options.kinds.push_back(found->kind);
+		} else if (!std::strcmp(argv[i], "--from") && i + 1 < argc) {
+			options.from = std::atof(argv[++i]);
+		} else if (!std::strcmp(argv[i], "--to") && i + 1 < argc) {
+			options.to = std::atof(argv[++i]);
+		} else if (argv[i][0] == '-') {
+			usage(argv[0]);
+		} else {
+			filenames.push_back(argv[i]);
+		}
+	}
+	if (filenames.empty()) {
+		usage(argv[0]);
+	}
+
+	Statistics stats;
+	for (const char *filename : filenames) {
+		process(filename, options, stats);
+	}
+	if (options.stats) {
+		print_statistics(stats);
+	}
+
+	google::protobuf::ShutdownProtobufLibrary();
+	return 0;
+}
@@ -0,0 +1,187 @@
+#include "eventlog.h"
+#include "eventlog.pb.h"
+#include "logger.h"
+#include "mappedfile.h"
+#include "rcon.pb.h"
+#include "referee.pb.h"
+#include "savestate.pb.h"
+#include "timing.h"
+#include <algorithm>
+#include <functional>
+#include <ios>
+#include <limits>
+#include <stdexcept>
+#include <glibmm/convert.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/ustring.h>
+
+#ifndef WIN32
+#include "exception.h"
+#include <unistd.h>
+#include <sys/types.h>
+#endif
+
+namespace {
+	const char EVENT_LOG_MAGIC[4] = {'S', 'S', 'L', 'E'};
+
+	// How many records may be queued before further ones are dropped.
+	const std::size_t QUEUE_CAPACITY = 4096;
+
+	// Frames a record with its length as a 4-byte big-endian integer.
+	std::string frame(const EventLogRecord &record) {
+		std::size_t byte_size = record.ByteSizeLong();
+		if (byte_size > std::numeric_limits<uint32_t>::max()) {
+			throw std::runtime_error("Protobuf error serializing event log record: too large to frame!");
+		}
+		uint32_t size = static_cast<uint32_t>(byte_size);
+		std::string data(4 + size, '\0');
+		data[0] = static_cast<char>(size >> 24);
+		data[1] = static_cast<char>(size >> 16);
+		data[2] = static_cast<char>(size >> 8);
+		data[3] = static_cast<char>(size);
+		record.SerializeWithCachedSizesToArray(reinterpret_cast<google::protobuf::uint8 *>(&data[4]));
+		return data;
+	}
+
+	// Returns how many bytes at the start of a file hold the event log magic and complete records, or zero if it is not an event log at all.
+	// Anything after that was cut off by a crash, and would misframe every record appended behind it.
+	std::size_t complete_length(const char *data, std::size_t size) {
+		if (size < sizeof(EVENT_LOG_MAGIC) || !std::equal(EVENT_LOG_MAGIC, EVENT_LOG_MAGIC + sizeof(EVENT_LOG_MAGIC), data)) {
+			return 0;
+		}
+		EventLogRecord record;
+		std::size_t pos = sizeof(EVENT_LOG_MAGIC);
+		while (size - pos >= 4) {
+			const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data + pos);
+			uint32_t length = (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+			if (length > size - pos - 4 || length > static_cast<uint32_t>(std::numeric_limits<int>::max()) || !record.ParsePartialFromArray(data + pos + 4, static_cast<int>(length))) {
+				break;
+			}
+			pos += 4 + length;
+		}
+		return pos;
+	}
+}
+
+EventLog::EventLog(Logger &logger, const std::string &filename, const Clock &clock, std::chrono::milliseconds flush_interval) :
+		logger(logger),
+		clock(clock),
+		enabled(!filename.empty()),
+		writer(enabled ? QUEUE_CAPACITY : 1, flush_interval, std::bind(&EventLog::write_batch, this, std::placeholders::_1, std::placeholders::_2)) {
+	if (!enabled) {
+		return;
+	}
+
+	// Append to an existing event log after its last complete record; anything else of the same name is replaced.
+	std::size_t length = 0;
+	bool torn = false;
+	std::ios_base::openmode mode = std::ios_base::out | std::ios_base::binary | std::ios_base::app;
+	if (Glib::file_test(filename, Glib::FILE_TEST_EXISTS)) {
+		MappedFile file(filename);
+		length = complete_length(file.data(), file.size());
+		torn = length && length < file.size();
+#ifdef WIN32
+		// There is no portable way to shorten a file, so keep the complete records in memory and write them back.
+		if (torn) {
+			batch.assign(file.data(), length);
+			mode = std::ios_base::out | std::ios_base::binary | std::ios_base::trunc;
+		}
+#endif
+	}
+	if (!length) {
+		mode = std::ios_base::out | std::ios_base::binary | std::ios_base::trunc;
+	}
+#ifndef WIN32
+	if (torn && ::truncate(filename.c_str(), static_cast<off_t>(length)) < 0) {
+		throw SystemError(Glib::locale_from_utf8(Glib::ustring::compose(u8"Error truncating event log %1", Glib::filename_to_utf8(filename))));
+	}
+#endif
+	ofs.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+	ofs.open(filename, mode);
+	if (!length) {
+		ofs.write(EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+	}
+	ofs.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+	batch.clear();
+
+	EventLogRecord start;
+	start.mutable_start()->set_wall_time(static_cast<uint64_t>(clock.wall().count()));
+	record(start);
+	writer.start();
+}
+
+EventLog::~EventLog() {
+	writer.stop();
+}
+
+void EventLog::publish(SaveState &state, unsigned int changes) {
+	if (!enabled) {
+		return;
+	}
+	const SSL_Referee &referee = state.referee();
+	EventLogRecord rec;
+	EventLogRecord::Publish &pub = *rec.mutable_publish();
+	pub.set_changes(changes);
+	pub.set_packet_timestamp(referee.packet_timestamp());
+	pub.set_command_counter(referee.command_counter());
+	record(rec);
+
+	if (changes & ~static_cast<unsigned int>(CHANGE_CLOCKS)) {
+		EventLogRecord transition;
+		transition.mutable_transition()->set_changes(changes);
+		transition.mutable_transition()->mutable_referee()->CopyFrom(referee);
+		record(transition);
+	}
+}
+
+std::chrono::microseconds EventLog::now() const {
+	return clock.monotonic();
+}
+
+void EventLog::remote_control(std::chrono::microseconds started, const SSL_RefereeRemoteControlRequest &request, const SSL_RefereeRemoteControlReply &reply, bool held, uint32_t command_counter) {
+	if (!enabled) {
+		return;
+	}
+	EventLogRecord rec;
+	rec.set_timestamp(static_cast<uint64_t>(started.count()));
+	EventLogRecord::RemoteControl &rc = *rec.mutable_remote_control();
+	rc.mutable_request()->CopyFrom(request);
+	rc.set_outcome(reply.outcome());
+	rc.set_held(held);
+	rc.set_command_counter(command_counter);
+	record(rec);
+}
+
+void EventLog::record(EventLogRecord &record) {
+	if (!record.has_timestamp()) {
+		record.set_timestamp(static_cast<uint64_t>(clock.monotonic().count()));
+	}
+	writer.push(frame(record));
+}
+
+void EventLog::write_batch(std::vector<std::string> &frames, uint64_t dropped) {
+	if (dropped) {
+		EventLogRecord rec;
+		rec.set_timestamp(static_cast<uint64_t>(clock.monotonic().count()));
+		rec.set_dropped(dropped);
+		batch = frame(rec);
+	}
+	for (const std::string &data : frames) {
+		batch += data;
+	}
+	if (!ofs.is_open()) {
+		batch.clear();
+		return;
+	}
+
+	// Write the whole batch with one call.
+	try {
+		ofs.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+		ofs.flush();
+	} catch (const std::ios_base::failure &exp) {
+		logger.write(Glib::ustring::compose(u8"Event log stopped: %1", Glib::locale_to_utf8(exp.what())));
+		ofs.exceptions(std::ios_base::goodbit);
+		ofs.close();
+	}
+	batch.clear();
+}
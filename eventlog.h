@@ -0,0 +1,52 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include "batchwriter.h"
+#include "noncopyable.h"
+#include "publisher.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Clock;
+class EventLogRecord;
+class Logger;
+class SaveState;
+class SSL_RefereeRemoteControlReply;
+class SSL_RefereeRemoteControlRequest;
+
+// Records publishes, state transitions, and remote control requests in a binary event log (see eventlog.proto) for analysis after the match.
+// Records are framed on the calling thread, queued without locking, and written out in batches by a background thread, so recording never blocks on I/O.
+class EventLog : public NonCopyable, public Publisher {
+	public:
+		// An empty filename records nothing.
+		// Records are timestamped with the monotonic time of the given clock, and wait at most the flush interval before being written out.
+		EventLog(Logger &logger, const std::string &filename, const Clock &clock, std::chrono::milliseconds flush_interval);
+
+		// Writes out everything still queued, then stops the writer thread.
+		~EventLog();
+
+		// Records a publish, and also a transition unless only the clocks changed.
+		void publish(SaveState &state, unsigned int changes);
+
+		// Returns the time to stamp a record with, for an event that is recorded only after it finishes.
+		std::chrono::microseconds now() const;
+
+		// Records a remote control request that began to be carried out, or held back, at the given time, with the command counter it left behind.
+		void remote_control(std::chrono::microseconds started, const SSL_RefereeRemoteControlRequest &request, const SSL_RefereeRemoteControlReply &reply, bool held, uint32_t command_counter);
+
+	private:
+		Logger &logger;
+		const Clock &clock;
+		const bool enabled;
+		std::ofstream ofs;
+		std::string batch;
+		BatchWriter<std::string> writer;
+
+		void record(EventLogRecord &record);
+		void write_batch(std::vector<std::string> &frames, uint64_t dropped);
+};
+
+#endif
@@ -4,34 +4,59 @@
 #include "publisher.h"
 #include "savegame.h"
 #include "teams.h"
+#include "udpbroadcast.h"
 #include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
+#include <utility>
 #include <glibmm/convert.h>
-#include <glibmm/main.h>
 #include <glibmm/ustring.h>
 #include <google/protobuf/descriptor.h>
 #include <sigc++/functors/mem_fun.h>
 
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
 namespace {
 	const uint32_t STATE_SAVE_INTERVAL = 5000000UL;
 }
 
-GameController::GameController(Logger &logger, const Configuration &configuration, const std::vector<Publisher *> &publishers, const std::string &resume_filename) :
+GameController::GameController(Logger &logger, const Configuration &configuration, const std::vector<Publisher *> &publishers, UDPTransmitter &transmitter, Clock &clock, const std::string &resume_filename) :
 		configuration(configuration),
 		logger(logger),
+		event_log(logger, configuration.event_log_filename, clock, std::chrono::milliseconds(configuration.log_flush_interval_milliseconds)),
 		publishers(publishers),
-		tick_connection(Glib::signal_timeout().connect(sigc::mem_fun(this, &GameController::tick), 25)),
-		microseconds_since_last_state_save(0) {
+		transmitter(transmitter),
+		clock(clock),
+		virtual_clock(dynamic_cast<VirtualClock *>(&clock)),
+		tick_period(1000000 / configuration.tick_rate),
+		save_writer(configuration.save_filename, clock, !resume_filename.empty()),
+		timer(clock),
+		microseconds_since_last_state_save(0),
+		microseconds_since_last_publish(0),
+		unpublished_changes(Publisher::CHANGE_ALL),
+		pending_notifications(0),
+#ifdef __linux__
+		tick_task_wake(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "Cannot create tick task wakeup event"),
+#endif
+		scheduler(logger, tick_period, std::bind(&GameController::run_on_tick_thread, this, &GameController::tick)) {
+	dispatcher.connect(sigc::mem_fun(this, &GameController::on_dispatch));
+
+	// Keep the set of interfaces to send on up to date as network interfaces come and go.
+	if (transmitter.interface_watch_fd() >= 0) {
+		scheduler.watch(transmitter.interface_watch_fd(), std::bind(&GameController::run_on_tick_thread, this, &GameController::on_interface_watch));
+	}
+#ifdef __linux__
+	// Let other threads, such as a remote control thread, hand work to the tick thread.
+	scheduler.watch(tick_task_wake, std::bind(&GameController::run_on_tick_thread, this, &GameController::on_tick_task_wake));
+#endif
+
 	if (!resume_filename.empty()) {
-		std::ifstream ifs;
-		ifs.exceptions(std::ios_base::badbit);
-		ifs.open(resume_filename, std::ios_base::in | std::ios_base::binary);
-		if (!state.ParseFromIstream(&ifs)) {
-			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Protobuf error loading saved game state from file \"%1\"!", Glib::filename_to_utf8(resume_filename))));
-		}
-		ifs.close();
+		load_game(state, resume_filename);
 		set_command(SSL_Referee::HALT);
 	} else {
 		SSL_Referee &ref = *state.mutable_referee();
@@ -39,7 +64,7 @@ GameController::GameController(Logger &logger, const Configuration &configuratio
 		ref.set_stage(SSL_Referee::NORMAL_FIRST_HALF_PRE);
 		ref.set_command(SSL_Referee::HALT);
 		ref.set_command_counter(0);
-		ref.set_command_timestamp(static_cast<uint64_t>(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())) * 1000000UL);
+		ref.set_command_timestamp(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(clock.wall()).count()) * 1000000UL);
 		ref.set_blueteamonpositivehalf(false);
 
 		for (unsigned int teami = 0; teami < 2; ++teami) {
@@ -58,21 +83,33 @@ GameController::GameController(Logger &logger, const Configuration &configuratio
 		state.set_blue_penalty_goals(0);
 		state.set_time_taken(0);
 	}
+
+	// Give remote control subscribers a starting point before anything is published.
+	state_feed.publish(state, Publisher::CHANGE_ALL);
+
+	// Start running the clocks now that the state is ready, unless time only passes when the driver says so.
+	if (virtual_clock) {
+		logger.write(u8"Running in virtual time.");
+	} else {
+		scheduler.start();
+	}
 }
 
 GameController::~GameController() {
-	// Disconnect the timer connection.
-	tick_connection.disconnect();
+	// Stop the tick thread so nothing else touches the state.
+	scheduler.stop();
 
-	// Try to save the current game state.
+	// Try to save the current game state and wait for it, and anything still queued, to reach the disk.
 	try {
-		save_game(state, configuration.save_filename);
+		save_writer.submit(state, SaveJournalRecord::OTHER);
+		save_writer.flush();
 	} catch (...) {
 		// Swallow exceptions.
 	}
 }
 
 bool GameController::can_enter_stage(SSL_Referee::Stage stage) const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	const SSL_Referee &ref = state.referee();
 	bool is_stopped = ref.command() == SSL_Referee::STOP || ref.command() == SSL_Referee::GOAL_YELLOW || ref.command() == SSL_Referee::GOAL_BLUE;
 	bool is_normal_half = ref.stage() == SSL_Referee::NORMAL_FIRST_HALF || ref.stage() == SSL_Referee::NORMAL_SECOND_HALF || ref.stage() == SSL_Referee::EXTRA_FIRST_HALF || ref.stage() == SSL_Referee::EXTRA_SECOND_HALF;
@@ -119,6 +156,7 @@ bool GameController::can_enter_stage(SSL_Referee::Stage stage) const {
 }
 
 void GameController::enter_stage(SSL_Referee::Stage stage) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 
 	// Record what’s happening.
@@ -126,6 +164,7 @@ void GameController::enter_stage(SSL_Referee::Stage stage) {
 
 	// Set the new stage.
 	ref.set_stage(stage);
+	mark_changed(Publisher::CHANGE_STAGE);
 
 	// Reset the stage time taken.
 	state.set_time_taken(0);
@@ -166,6 +205,7 @@ void GameController::enter_stage(SSL_Referee::Stage stage) {
 }
 
 SSL_Referee::Stage GameController::next_half_time() const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	const SSL_Referee &ref = state.referee();
 
 	// Which stage to go into depends on which stage we are already in.
@@ -195,6 +235,7 @@ SSL_Referee::Stage GameController::next_half_time() const {
 }
 
 bool GameController::can_set_command(SSL_Referee::Command command) const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	const SSL_Referee &ref = state.referee();
 	bool is_normal_half = ref.stage() == SSL_Referee::NORMAL_FIRST_HALF || ref.stage() == SSL_Referee::NORMAL_SECOND_HALF || ref.stage() == SSL_Referee::EXTRA_FIRST_HALF || ref.stage() == SSL_Referee::EXTRA_SECOND_HALF;
 	bool is_break = ref.stage() == SSL_Referee::NORMAL_HALF_TIME || ref.stage() == SSL_Referee::EXTRA_TIME_BREAK || ref.stage() == SSL_Referee::EXTRA_HALF_TIME || ref.stage() == SSL_Referee::PENALTY_SHOOTOUT_BREAK;
@@ -292,15 +333,18 @@ bool GameController::command_needs_designated_position(SSL_Referee::Command comm
 }
 
 void GameController::set_game_event(const SSL_Referee_Game_Event *game_event) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     SSL_Referee *ref = state.mutable_referee();
 
     // copy game event from request
     if(game_event != NULL) {
         ref->mutable_gameevent()->CopyFrom(*game_event);
+        mark_changed(Publisher::CHANGE_OTHER);
     }
 }
 
 void GameController::set_command(SSL_Referee::Command command, float designated_x, float designated_y, bool cancelling_timeout_end) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee *ref = state.mutable_referee();
 
 	// Record what’s happening.
@@ -399,23 +443,29 @@ void GameController::set_command(SSL_Referee::Command command, float designated_
 	ref->set_command_counter(ref->command_counter() + 1);
 
 	// Record the command timestamp.
-	std::chrono::microseconds diff = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(0));
-	ref->set_command_timestamp(static_cast<uint64_t>(diff.count()));
+	ref->set_command_timestamp(static_cast<uint64_t>(clock.wall().count()));
 
 	// We should save the game state now.
-	save_game(state, configuration.save_filename);
+	save_writer.submit(state, SaveJournalRecord::COMMAND);
+
+	// Send the new command out right away rather than waiting for the next tick.
+	mark_changed(Publisher::CHANGE_COMMAND);
+	publish();
 
 	// Notify listeners of the state change.
-	signal_other_changed.emit();
+	notify(NOTIFY_OTHER);
 }
 
 void GameController::set_teamname(SaveState::Team team, const Glib::ustring &name) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 	TeamMeta::ALL[team].team_info(ref).set_name(name.raw());
-	signal_teamname_changed.emit();
+	mark_changed(Publisher::CHANGE_OTHER);
+	notify(NOTIFY_TEAMNAME);
 }
 
 bool GameController::can_set_goalie() const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	// You can change goalies whenever the game is stopped or halted except in post-game.
 	const SSL_Referee &ref = state.referee();
 	bool is_stopped = ref.command() == SSL_Referee::STOP || ref.command() == SSL_Referee::GOAL_YELLOW || ref.command() == SSL_Referee::GOAL_BLUE;
@@ -423,11 +473,15 @@ bool GameController::can_set_goalie() const {
 }
 
 void GameController::set_goalie(SaveState::Team team, unsigned int goalie) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 	TeamMeta::ALL[team].team_info(ref).set_goalie(goalie);
+	mark_changed(Publisher::CHANGE_OTHER);
+	save_writer.submit(state, SaveJournalRecord::OTHER);
 }
 
 bool GameController::can_switch_colours() const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	// You can switch colours when you are halted in a break or pre-half.
 	const SSL_Referee &ref = state.referee();
 	bool is_break = ref.stage() == SSL_Referee::NORMAL_HALF_TIME || ref.stage() == SSL_Referee::EXTRA_TIME_BREAK || ref.stage() == SSL_Referee::EXTRA_HALF_TIME || ref.stage() == SSL_Referee::PENALTY_SHOOTOUT_BREAK;
@@ -436,10 +490,12 @@ bool GameController::can_switch_colours() const {
 }
 
 bool GameController::can_switch_sides() const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	return can_switch_colours();
 }
 
 void GameController::switch_colours() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	logger.write(u8"Switching colours.");
 	SSL_Referee &ref = *state.mutable_referee();
 
@@ -456,26 +512,33 @@ void GameController::switch_colours() {
 		state.mutable_timeout()->set_team(TeamMeta::ALL[state.timeout().team()].other());
 	}
 
-	signal_other_changed.emit();
+	mark_changed(Publisher::CHANGE_OTHER);
+	save_writer.submit(state, SaveJournalRecord::OTHER);
+	notify(NOTIFY_OTHER);
 }
 
 void GameController::switch_sides(bool blueTeamOnPositiveHalf) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	logger.write(Glib::ustring::compose(u8"Switching sides: %1 Team on positive half", blueTeamOnPositiveHalf ? "Blue" : "Yellow"));
 
 	SSL_Referee &ref = *state.mutable_referee();
 
 	ref.set_blueteamonpositivehalf(blueTeamOnPositiveHalf);
 
-	signal_other_changed.emit();
+	mark_changed(Publisher::CHANGE_OTHER);
+	save_writer.submit(state, SaveJournalRecord::OTHER);
+	notify(NOTIFY_OTHER);
 }
 
 bool GameController::can_subtract_goal(SaveState::Team team) const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	// You can subtract goals whenever you are stopped and the team has points.
 	const SSL_Referee &ref = state.referee();
 	return (ref.command() == SSL_Referee::STOP || ref.command() == SSL_Referee::GOAL_YELLOW || ref.command() == SSL_Referee::GOAL_BLUE) && TeamMeta::ALL[team].team_info(ref).score();
 }
 
 void GameController::subtract_goal(SaveState::Team team) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 	SSL_Referee::TeamInfo &ti = TeamMeta::ALL[team].team_info(ref);
 
@@ -489,10 +552,13 @@ void GameController::subtract_goal(SaveState::Team team) {
 		TeamMeta::ALL[team].set_penalty_goals(state, TeamMeta::ALL[team].penalty_goals(state) - 1);
 	}
 
-	signal_other_changed.emit();
+	mark_changed(Publisher::CHANGE_OTHER);
+	save_writer.submit(state, SaveJournalRecord::OTHER);
+	notify(NOTIFY_OTHER);
 }
 
 GameController::CancelType GameController::cancel_type() const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	const SSL_Referee &ref = state.referee();
 	if (ref.stage() == SSL_Referee::POST_GAME) {
 		// You can never cancel anything in post-game.
@@ -513,6 +579,7 @@ GameController::CancelType GameController::cancel_type() const {
 }
 
 void GameController::cancel() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 
 	switch (cancel_type()) {
@@ -538,6 +605,9 @@ void GameController::cancel() {
 						break;
 				}
 				state.clear_last_card();
+				save_writer.submit(state, SaveJournalRecord::CARD);
+				mark_changed(Publisher::CHANGE_CARDS);
+				publish();
 			}
 			break;
 
@@ -563,15 +633,17 @@ void GameController::cancel() {
 			break;
 	}
 
-	signal_other_changed.emit();
+	notify(NOTIFY_OTHER);
 }
 
 bool GameController::can_issue_card() const {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	const SSL_Referee &ref = state.referee();
 	return ref.command() == SSL_Referee::STOP || ref.command() == SSL_Referee::GOAL_YELLOW || ref.command() == SSL_Referee::GOAL_BLUE;
 }
 
 void GameController::yellow_card(SaveState::Team team) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 	SSL_Referee::TeamInfo &ti = TeamMeta::ALL[team].team_info(ref);
 	logger.write(Glib::ustring::compose(u8"Issuing yellow card to %1.", TeamMeta::ALL[team].COLOUR));
@@ -584,10 +656,17 @@ void GameController::yellow_card(SaveState::Team team) {
 	state.mutable_last_card()->set_team(team);
 	state.mutable_last_card()->set_card(SaveState::CARD_YELLOW);
 
-	signal_other_changed.emit();
+	save_writer.submit(state, SaveJournalRecord::CARD);
+
+	// Send the new card out right away rather than waiting for the next tick.
+	mark_changed(Publisher::CHANGE_CARDS);
+	publish();
+
+	notify(NOTIFY_OTHER);
 }
 
 void GameController::red_card(SaveState::Team team) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
 	SSL_Referee &ref = *state.mutable_referee();
 	SSL_Referee::TeamInfo &ti = TeamMeta::ALL[team].team_info(ref);
 	logger.write(Glib::ustring::compose(u8"Issuing red card to %1.", TeamMeta::ALL[team].COLOUR));
@@ -599,10 +678,16 @@ void GameController::red_card(SaveState::Team team) {
 	state.mutable_last_card()->set_team(team);
 	state.mutable_last_card()->set_card(SaveState::CARD_RED);
 
-	signal_other_changed.emit();
+	save_writer.submit(state, SaveJournalRecord::CARD);
+
+	// Send the new card out right away rather than waiting for the next tick.
+	mark_changed(Publisher::CHANGE_CARDS);
+	publish();
+
+	notify(NOTIFY_OTHER);
 }
 
-bool GameController::tick() {
+void GameController::tick() {
 	SSL_Referee &ref = *state.mutable_referee();
 
 	// Read how many microseconds passed since the last tick.
@@ -612,7 +697,7 @@ bool GameController::tick() {
 	microseconds_since_last_state_save += delta;
 	if (microseconds_since_last_state_save > STATE_SAVE_INTERVAL) {
 		microseconds_since_last_state_save = 0;
-		save_game(state, configuration.save_filename);
+		save_writer.submit(state, SaveJournalRecord::CLOCK);
 	}
 
 	// Pull out the current command for checking against.
@@ -649,8 +734,11 @@ bool GameController::tick() {
 		uint32_t new_left = old_left > delta ? old_left - delta : 0;
 		uint32_t new_tenths = new_left / 100000;
 		ti.set_timeout_time(new_left);
+		if (new_left != old_left) {
+			mark_changed(Publisher::CHANGE_CLOCKS);
+		}
 		if (new_tenths != old_tenths) {
-			signal_timeout_time_changed.emit();
+			notify(NOTIFY_TIMEOUT_TIME);
 		}
 	} else if (!stopped_game_time || half_time_like) {
 		// Otherwise, as long as we are not in halt OR we are in a half-time-like stage, the stage clock runs, if this particular stage *has* a stage clock.
@@ -679,8 +767,11 @@ bool GameController::tick() {
 					emit = true;
 				}
 			}
+			if (delta) {
+				mark_changed(Publisher::CHANGE_CLOCKS);
+			}
 			if (emit) {
-				signal_game_clock_changed.emit();
+				notify(NOTIFY_GAME_CLOCK);
 			}
 		}
 
@@ -692,6 +783,9 @@ bool GameController::tick() {
 				if (ti.yellow_card_times_size()) {
 					// Tick down all the counters.
 					bool emit = false;
+					if (delta) {
+						mark_changed(Publisher::CHANGE_CLOCKS);
+					}
 					for (int j = 0; j < ti.yellow_card_times_size(); ++j) {
 						uint32_t old_left = ti.yellow_card_times(j);
 						uint32_t old_tenths = old_left / 100000;
@@ -707,6 +801,7 @@ bool GameController::tick() {
 					if (!ti.yellow_card_times(0)) {
 						auto last_valid = std::remove(ti.mutable_yellow_card_times()->begin(), ti.mutable_yellow_card_times()->end(), 0);
 						ti.mutable_yellow_card_times()->Truncate(static_cast<int>(last_valid - ti.mutable_yellow_card_times()->begin()));
+						mark_changed(Publisher::CHANGE_CARDS);
 						emit = true;
 					}
 
@@ -715,25 +810,150 @@ bool GameController::tick() {
 						if (state.has_last_card()) {
 							if (state.last_card().team() == team && state.last_card().card() == SaveState::CARD_YELLOW) {
 								state.clear_last_card();
-								signal_other_changed.emit();
+								notify(NOTIFY_OTHER);
 							}
 						}
 					}
 
 					if (emit) {
-						signal_yellow_card_time_changed.emit();
+						notify(NOTIFY_YELLOW_CARD_TIME);
 					}
 				}
 			}
 		}
 	}
 
-	// Publish the current state.
-	for (Publisher *pub : publishers) {
-		pub->publish(state);
+	// Publish the current state periodically.
+	// Urgent changes have already been published as they happened; anything else, such as running clocks, goes out with the next periodic packet.
+	microseconds_since_last_publish += delta;
+	if (microseconds_since_last_publish >= configuration.publish_interval_milliseconds * 1000ULL) {
+		publish();
+	}
+}
+
+void GameController::on_interface_watch() {
+	transmitter.update_interfaces();
+}
+
+bool GameController::is_virtual_time() const {
+	return virtual_clock != nullptr;
+}
+
+void GameController::advance_time(std::chrono::microseconds duration) {
+	if (!virtual_clock) {
+		throw std::logic_error("Time can only be advanced explicitly in virtual time");
+	}
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	while (duration.count() > 0) {
+		std::chrono::microseconds step = std::min(duration, tick_period);
+		virtual_clock->advance(step);
+		tick();
+		duration -= step;
+	}
+}
+
+TickScheduler::Statistics GameController::tick_statistics() const {
+	return scheduler.statistics();
+}
+
+bool GameController::has_tick_tasks() const {
+#ifdef __linux__
+	return !virtual_clock;
+#else
+	return false;
+#endif
+}
+
+void GameController::set_tick_task(const std::function<void()> &task) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	tick_task = task;
+}
+
+void GameController::wake_tick_task() {
+#ifdef __linux__
+	uint64_t one = 1;
+	if (write(tick_task_wake, &one, sizeof(one)) < 0) {
+		// The event counter can only fail to accept a write if it would overflow, in which case it is already readable.
+	}
+#endif
+}
+
+void GameController::on_tick_task_wake() {
+#ifdef __linux__
+	uint64_t count;
+	if (read(tick_task_wake, &count, sizeof(count)) != sizeof(count)) {
+		return;
+	}
+#endif
+	if (tick_task) {
+		tick_task();
+	}
+}
+
+void GameController::run_on_tick_thread(void (GameController::*fn)()) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	try {
+		(this->*fn)();
+	} catch (...) {
+		// An exception cannot leave the tick thread, so pass the first one to the main loop to be rethrown there.
+		if (!tick_thread_error) {
+			tick_thread_error = std::current_exception();
+		}
+		notify(NOTIFY_ERROR);
+	}
+}
+
+void GameController::notify(unsigned int notifications) {
+	// Only wake the main loop if it has not already been woken for notifications it has yet to collect.
+	if (!pending_notifications.fetch_or(notifications)) {
+		dispatcher.emit();
 	}
+}
+
+void GameController::on_dispatch() {
+	unsigned int notifications = pending_notifications.exchange(0);
+	if (notifications & NOTIFY_ERROR) {
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			std::swap(error, tick_thread_error);
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+	if (notifications & NOTIFY_TIMEOUT_TIME) {
+		signal_timeout_time_changed.emit();
+	}
+	if (notifications & NOTIFY_GAME_CLOCK) {
+		signal_game_clock_changed.emit();
+	}
+	if (notifications & NOTIFY_YELLOW_CARD_TIME) {
+		signal_yellow_card_time_changed.emit();
+	}
+	if (notifications & NOTIFY_TEAMNAME) {
+		signal_teamname_changed.emit();
+	}
+	if (notifications & NOTIFY_OTHER) {
+		signal_other_changed.emit();
+	}
+}
 
-	return true;
+void GameController::mark_changed(unsigned int changes) {
+	unpublished_changes |= changes;
+}
+
+void GameController::publish() {
+	state.mutable_referee()->set_packet_timestamp(static_cast<uint64_t>(clock.wall().count()));
+	for (Publisher *pub : publishers) {
+		pub->publish(state, unpublished_changes);
+	}
+	// Send the datagrams from all the publishers together.
+	transmitter.flush();
+	state_feed.publish(state, unpublished_changes);
+	event_log.publish(state, unpublished_changes);
+	unpublished_changes = 0;
+	microseconds_since_last_publish = 0;
 }
 
 void GameController::advance_from_pre() {
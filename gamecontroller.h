@@ -1,21 +1,31 @@
 #ifndef GAMECONTROLLER_H
 #define GAMECONTROLLER_H
 
+#include "eventlog.h"
 #include "noncopyable.h"
 #include "referee.pb.h"
+#include "savegame.h"
 #include "savestate.pb.h"
+#include "statefeed.h"
+#include "tickscheduler.h"
 #include "timing.h"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
+#include <glibmm/dispatcher.h>
 #include <glibmm/ustring.h>
-#include <sigc++/connection.h>
 #include <sigc++/signal.h>
 
 class Configuration;
 class GameInfo;
 class Logger;
 class Publisher;
+class UDPTransmitter;
 
 class GameController : public NonCopyable {
 	public:
@@ -26,12 +36,24 @@ class GameController : public NonCopyable {
 			TIMEOUT_END,
 		};
 
+		// The game clocks run on a dedicated tick thread.
+		// Every member function takes this lock itself; hold it while reading state from outside the controller.
+		mutable std::recursive_mutex mutex;
 		SaveState state;
 		const Configuration &configuration;
 		Logger &logger;
+
+		// Deltas of the state for remote control subscribers, made on every publish.
+		StateFeed state_feed;
+
+		// A binary record of the match for analysis afterwards; may be written to from any thread.
+		EventLog event_log;
+
+		// These signals are always emitted on the thread running the main loop, shortly after the change, without the lock held.
 		sigc::signal<void> signal_timeout_time_changed, signal_game_clock_changed, signal_yellow_card_time_changed, signal_teamname_changed, signal_other_changed;
 
-		GameController(Logger &logger, const Configuration &configuration, const std::vector<Publisher *> &publishers, const std::string &resume_filename);
+		// If clock is a VirtualClock, the game runs in virtual time: nothing happens on its own, and time passes only through advance_time.
+		GameController(Logger &logger, const Configuration &configuration, const std::vector<Publisher *> &publishers, UDPTransmitter &transmitter, Clock &clock, const std::string &resume_filename);
 		~GameController();
 
 		bool can_enter_stage(SSL_Referee::Stage stage) const;
@@ -64,13 +86,60 @@ class GameController : public NonCopyable {
 		void yellow_card(SaveState::Team team);
 		void red_card(SaveState::Team team);
 
+		bool is_virtual_time() const;
+
+		// Advances virtual time by running ticks of the configured length, and a shorter final one if needed, exactly as if that much time had passed.
+		void advance_time(std::chrono::microseconds duration);
+
+		// Returns the tick timing statistics, including the lateness histogram, since the controller started.
+		TickScheduler::Statistics tick_statistics() const;
+
+		// Returns whether the tick thread can run tasks for other threads; it cannot in virtual time, or where it cannot be woken, which is anywhere but Linux.
+		bool has_tick_tasks() const;
+
+		// Sets the task run on the tick thread, with the lock held, each time wake_tick_task is called; an empty function removes it.
+		void set_tick_task(const std::function<void()> &task);
+
+		// Wakes the tick thread to run the task as soon as it can; safe to call from any thread.
+		void wake_tick_task();
+
 	private:
+		enum Notification {
+			NOTIFY_TIMEOUT_TIME = 1 << 0,
+			NOTIFY_GAME_CLOCK = 1 << 1,
+			NOTIFY_YELLOW_CARD_TIME = 1 << 2,
+			NOTIFY_TEAMNAME = 1 << 3,
+			NOTIFY_OTHER = 1 << 4,
+			NOTIFY_ERROR = 1 << 5,
+		};
+
 		const std::vector<Publisher *> &publishers;
-		sigc::connection tick_connection;
+		UDPTransmitter &transmitter;
+		Clock &clock;
+		VirtualClock *const virtual_clock;
+		const std::chrono::microseconds tick_period;
+		SaveWriter save_writer;
 		MicrosecondCounter timer;
 		uint64_t microseconds_since_last_state_save;
-
-		bool tick();
+		uint64_t microseconds_since_last_publish;
+		unsigned int unpublished_changes;
+		std::atomic<unsigned int> pending_notifications;
+		std::exception_ptr tick_thread_error;
+		Glib::Dispatcher dispatcher;
+		std::function<void()> tick_task;
+#ifdef __linux__
+		Descriptor tick_task_wake;
+#endif
+		TickScheduler scheduler;
+
+		void run_on_tick_thread(void (GameController::*fn)());
+		void tick();
+		void on_interface_watch();
+		void on_tick_task_wake();
+		void notify(unsigned int notifications);
+		void on_dispatch();
+		void mark_changed(unsigned int changes);
+		void publish();
 		void advance_from_pre();
 };
 
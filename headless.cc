@@ -0,0 +1,143 @@
+#include "configuration.h"
+#include "engine.h"
+#include "logger.h"
+#include "rconsrv.h"
+#include "timing.h"
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <string>
+#include <giomm/init.h>
+#include <glibmm/exception.h>
+#include <glibmm/main.h>
+#include <glibmm/optioncontext.h>
+#include <glibmm/optionentry.h>
+#include <glibmm/optiongroup.h>
+#include <google/protobuf/stubs/common.h>
+
+#ifndef WIN32
+#include <csignal>
+#include <glib-unix.h>
+#endif
+
+namespace {
+#ifndef WIN32
+	gboolean on_quit_signal(gpointer main_loop) {
+		g_main_loop_quit(static_cast<GMainLoop *>(main_loop));
+		return TRUE;
+	}
+#endif
+
+	int main_impl(int argc, char **argv) {
+		// Set the current locale.
+		std::locale::global(std::locale(""));
+
+		// Initialize Glib and Gio; nothing else is needed without a user interface.
+		Gio::init();
+
+		// Parse the command-line arguments.
+		Glib::OptionContext option_context;
+		option_context.set_summary(u8"Runs the RoboCup Small Size League Referee Box without a user interface, controlled only by remote control.");
+		option_context.set_description(u8"The Referee Box is © RoboCup Federation, 2003–2013.");
+
+		Glib::OptionGroup option_group(u8"referee", u8"Referee Box Options", u8"Show Referee Box Options");
+
+		Glib::OptionEntry config_file_entry;
+		config_file_entry.set_long_name(u8"config");
+		config_file_entry.set_short_name('C');
+		config_file_entry.set_description(u8"Sets the name of the configuration file (defaults to referee.conf).");
+		config_file_entry.set_arg_description(u8"CONFIGFILE");
+		std::string config_filename("referee.conf");
+		option_group.add_entry_filename(config_file_entry, config_filename);
+
+		Glib::OptionEntry resume_entry;
+		resume_entry.set_long_name(u8"resume");
+		resume_entry.set_short_name('r');
+		resume_entry.set_description(u8"Resumes an in-progress game by replaying a game journal or loading a saved state file.");
+		resume_entry.set_arg_description(u8"SAVEFILE");
+		std::string resume_filename;
+		option_group.add_entry_filename(resume_entry, resume_filename);
+
+		Glib::OptionEntry virtual_time_entry;
+		virtual_time_entry.set_long_name(u8"virtual-time");
+		virtual_time_entry.set_description(u8"Runs the game in virtual time, starting at the Unix epoch and advancing only when remote control requests ask for it, for reproducible simulated matches.");
+		bool virtual_time = false;
+		option_group.add_entry(virtual_time_entry, virtual_time);
+
+		option_context.set_main_group(option_group);
+		option_context.parse(argc, argv);
+
+		// Initialize the game objects.
+		Configuration configuration(config_filename);
+
+		// Start a logger.
+		Logger logger(configuration.log_filename, std::chrono::milliseconds(configuration.log_flush_interval_milliseconds));
+		configuration.dump(logger);
+
+		{
+			// Construct the game engine.
+			VirtualClock virtual_clock(std::chrono::microseconds(0));
+			Engine engine(logger, configuration, resume_filename, virtual_time ? static_cast<Clock &>(virtual_clock) : SystemClock::instance());
+
+			// Without a user interface, remote control is the only way to run the game, so it is always enabled if a port is configured.
+			std::unique_ptr<RConServer> rcon_server;
+			if (configuration.rcon_port) {
+				rcon_server.reset(new RConServer(engine.controller()));
+			} else {
+				logger.write(u8"Warning: no remote control port is configured, so the game cannot be controlled.");
+			}
+
+			// Run until asked to stop, then shut down cleanly so the game journal is complete.
+			Glib::RefPtr<Glib::MainLoop> main_loop = Glib::MainLoop::create();
+#ifndef WIN32
+			g_unix_signal_add(SIGINT, &on_quit_signal, main_loop->gobj());
+			g_unix_signal_add(SIGTERM, &on_quit_signal, main_loop->gobj());
+#endif
+			main_loop->run();
+			logger.write(u8"Shutting down.");
+		}
+
+		// Shut down protobuf.
+		google::protobuf::ShutdownProtobufLibrary();
+
+		return 0;
+	}
+
+	void print_exception(const Glib::Exception &exp) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+	}
+
+	void print_exception(const std::exception &exp, bool first = true) {
+		if (first) {
+			std::cerr << "\nUnhandled exception:\n";
+		} else {
+			std::cerr << "Caused by:\n";
+		}
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+		try {
+			std::rethrow_if_nested(exp);
+		} catch (const std::exception &exp) {
+			print_exception(exp, false);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	try {
+		return main_impl(argc, argv);
+	} catch (const Glib::Exception &exp) {
+		print_exception(exp);
+	} catch (const std::exception &exp) {
+		print_exception(exp);
+	} catch (...) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   Unknown\n";
+		std::cerr << "Detail: Unknown\n";
+	}
+	return 1;
+}
@@ -52,10 +52,10 @@ namespace {
 	}
 }
 
-LegacyPublisher::LegacyPublisher(const Configuration &configuration, Logger &logger) : bcast(logger, configuration.address, configuration.legacy_port, configuration.interface), cached_command_char('H'), last_stage(SSL_Referee::NORMAL_FIRST_HALF_PRE), last_command(SSL_Referee::HALT), last_yellow_ycards(0), last_blue_ycards(0), last_yellow_rcards(0), last_blue_rcards(0) {
+LegacyPublisher::LegacyPublisher(const Configuration &configuration, UDPTransmitter &transmitter) : bcast(transmitter, configuration.address, configuration.legacy_port), cached_command_char('H'), last_stage(SSL_Referee::NORMAL_FIRST_HALF_PRE), last_command(SSL_Referee::HALT), last_yellow_ycards(0), last_blue_ycards(0), last_yellow_rcards(0), last_blue_rcards(0) {
 }
 
-void LegacyPublisher::publish(SaveState &state) {
+void LegacyPublisher::publish(SaveState &state, unsigned int) {
 	// Encode the packet.
 	uint8_t packet[6];
 	packet[0] = static_cast<uint8_t>(compute_command(state.referee()));
@@ -7,13 +7,16 @@
 #include "udpbroadcast.h"
 
 class Configuration;
-class Logger;
+class UDPTransmitter;
 class SaveState;
 
 class LegacyPublisher : public NonCopyable, public Publisher {
 	public:
-		LegacyPublisher(const Configuration &configuration, Logger &logger);
-		void publish(SaveState &state);
+		LegacyPublisher(const Configuration &configuration, UDPTransmitter &transmitter);
+		void publish(SaveState &state, unsigned int changes);
+
+		// Returns the command character to announce for a state, given the states announced before it.
+		char compute_command(const SSL_Referee &state);
 
 	private:
 		UDPBroadcast bcast;
@@ -22,8 +25,6 @@ class LegacyPublisher : public NonCopyable, public Publisher {
 		SSL_Referee::Command last_command;
 		int last_yellow_ycards, last_blue_ycards;
 		unsigned int last_yellow_rcards, last_blue_rcards;
-
-		char compute_command(const SSL_Referee &state);
 };
 
 #endif
@@ -1,15 +1,25 @@
 #include "logger.h"
 #include <cwchar>
+#include <functional>
 #include <iomanip>
+#include <ios>
 #include <iostream>
 #include <locale>
 #include <sstream>
 
-Logger::Logger(const std::string &filename) : start_time(std::chrono::high_resolution_clock::now()) {
+namespace {
+	// How many messages may be queued before further ones are dropped.
+	const std::size_t QUEUE_CAPACITY = 4096;
+}
+
+Logger::Logger(const std::string &filename, std::chrono::milliseconds flush_interval) :
+		start_time(std::chrono::steady_clock::now()),
+		writer(QUEUE_CAPACITY, flush_interval, std::bind(&Logger::write_batch, this, std::placeholders::_1, std::placeholders::_2)) {
 	if (!filename.empty()) {
 		ofs.exceptions(std::ios_base::badbit | std::ios_base::failbit);
 		ofs.open(filename, std::ios_base::out | std::ios_base::app);
 	}
+	writer.start();
 	std::time_t real_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 	std::wostringstream oss;
 	static const wchar_t TIME_PATTERN[] = L"%x %X %Z";
@@ -17,11 +27,42 @@ Logger::Logger(const std::string &filename) : start_time(std::chrono::high_resol
 	write(Glib::ustring::compose(u8"Referee box started at %1.", oss.str()));
 }
 
+Logger::~Logger() {
+	writer.stop();
+}
+
 void Logger::write(const Glib::ustring &message) {
-	std::chrono::high_resolution_clock::duration diff = std::chrono::high_resolution_clock::now() - start_time;
-	double seconds = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()) / 1000.0;
-	const Glib::ustring &prefixed = Glib::ustring::compose(u8"[%1] %2\n", Glib::ustring::format(std::fixed, std::setprecision(3), seconds), message);
-	std::cout << prefixed;
-	ofs << prefixed;
+	// Only take the time and a copy here; formatting and I/O happen on the writer thread.
+	writer.push(Record{std::chrono::steady_clock::now(), message.raw()});
 }
 
+void Logger::write_batch(std::vector<Record> &records, uint64_t dropped) {
+	for (const Record &record : records) {
+		append(record.time, record.message);
+	}
+	if (dropped) {
+		append(std::chrono::steady_clock::now(), Glib::ustring::compose(u8"Dropped %1 log messages because the log queue was full.", dropped));
+	}
+
+	// Write the whole batch with one call to each destination.
+	std::cout.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+	std::cout.flush();
+	if (ofs.is_open()) {
+		try {
+			ofs.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+			ofs.flush();
+		} catch (const std::ios_base::failure &) {
+			// There is no caller to report to on this thread, so say so on the console and carry on without the file.
+			std::cerr << "Cannot write log file; further messages go only to the console.\n";
+			ofs.exceptions(std::ios_base::goodbit);
+			ofs.close();
+		}
+	}
+	batch.clear();
+}
+
+void Logger::append(std::chrono::steady_clock::time_point time, const Glib::ustring &message) {
+	std::chrono::steady_clock::duration diff = time - start_time;
+	double seconds = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()) / 1000.0;
+	batch.append(Glib::ustring::compose(u8"[%1] %2\n", Glib::ustring::format(std::fixed, std::setprecision(3), seconds), message).raw());
+}
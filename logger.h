@@ -1,20 +1,41 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include "batchwriter.h"
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <string>
+#include <vector>
 #include <glibmm/ustring.h>
 
+// Writes timestamped messages to the console and, optionally, a log file.
+// Messages are queued without locking and written out in batches by a background thread, so logging never blocks the caller on I/O.
 class Logger {
 	public:
-		Logger(const std::string &log_filename);
+		// The flush interval is how long a message may wait before it is written out; the queue is also written out early when it fills halfway.
+		Logger(const std::string &log_filename, std::chrono::milliseconds flush_interval = std::chrono::milliseconds(250));
+
+		// Writes out everything still queued, then stops the writer thread.
+		~Logger();
+
+		// May be called from any thread.
+		// If the queue is full, the message is dropped and counted, and the count is logged once there is room.
 		void write(const Glib::ustring &message);
 
 	private:
-		std::chrono::high_resolution_clock::time_point start_time;
+		struct Record {
+			std::chrono::steady_clock::time_point time;
+			std::string message;
+		};
+
+		const std::chrono::steady_clock::time_point start_time;
 		std::ofstream ofs;
+		std::string batch;
+		BatchWriter<Record> writer;
+
+		void write_batch(std::vector<Record> &records, uint64_t dropped);
+		void append(std::chrono::steady_clock::time_point time, const Glib::ustring &message);
 };
 
 #endif
-
@@ -1,16 +1,12 @@
 #include "configuration.h"
-#include "gamecontroller.h"
-#include "legacypublisher.h"
+#include "engine.h"
 #include "logger.h"
 #include "mainwindow.h"
-#include "protobufpublisher.h"
-#include "publisher.h"
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <locale>
-#include <memory>
 #include <string>
-#include <vector>
 #include <glibmm/convert.h>
 #include <glibmm/exception.h>
 #include <glibmm/optioncontext.h>
@@ -42,7 +38,7 @@ namespace {
 		Glib::OptionEntry resume_entry;
 		resume_entry.set_long_name(u8"resume");
 		resume_entry.set_short_name('r');
-		resume_entry.set_description(u8"Resumes an in-progress game by loading a saved state file.");
+		resume_entry.set_description(u8"Resumes an in-progress game by replaying a game journal or loading a saved state file.");
 		resume_entry.set_arg_description(u8"SAVEFILE");
 		std::string resume_filename;
 		option_group.add_entry_filename(resume_entry, resume_filename);
@@ -54,28 +50,15 @@ namespace {
 		Configuration configuration(config_filename);
 
 		// Start a logger.
-		Logger logger(configuration.log_filename);
+		Logger logger(configuration.log_filename, std::chrono::milliseconds(configuration.log_flush_interval_milliseconds));
 		configuration.dump(logger);
 
-		// Construct the publishers.
-		std::vector<Publisher *> publishers;
-		std::unique_ptr<ProtobufPublisher> protobuf_publisher;
-		if (!configuration.protobuf_port.empty()) {
-			protobuf_publisher.reset(new ProtobufPublisher(configuration, logger));
-			publishers.push_back(protobuf_publisher.get());
+		{
+			// Construct the game engine and display a main window to control it.
+			Engine engine(logger, configuration, resume_filename);
+			MainWindow main_window(engine.controller());
+			kit.run(main_window);
 		}
-		std::unique_ptr<LegacyPublisher> legacy_publisher;
-		if (!configuration.legacy_port.empty()) {
-			legacy_publisher.reset(new LegacyPublisher(configuration, logger));
-			publishers.push_back(legacy_publisher.get());
-		}
-
-		// Construct the game controller that ties everything together.
-		GameController controller(logger, configuration, publishers, resume_filename);
-
-		// Create and display a main window.
-		MainWindow main_window(controller);
-		kit.run(main_window);
 
         // Shut down protobuf.
         google::protobuf::ShutdownProtobufLibrary();
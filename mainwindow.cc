@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <iomanip>
+#include <mutex>
 #include <glibmm/ustring.h>
 #include <sigc++/adaptors/bind.h>
 #include <sigc++/functors/mem_fun.h>
@@ -415,11 +416,13 @@ MainWindow::MainWindow(GameController &controller) :
 MainWindow::~MainWindow() = default;
 
 void MainWindow::on_timeout_time_changed() {
+	std::lock_guard<std::recursive_mutex> lock(controller.mutex);
 	yellow_timeout_time_text.set_text(format_time_deciseconds(controller.state.referee().yellow().timeout_time()));
 	blue_timeout_time_text.set_text(format_time_deciseconds(controller.state.referee().blue().timeout_time()));
 }
 
 void MainWindow::on_game_clock_changed() {
+	std::lock_guard<std::recursive_mutex> lock(controller.mutex);
 	// The penalty shootout renders in a special way; there is no game clock during that time, instead, it shows a penalty goal count.
 	// Thus, only show the clock if we are not in the penalty shootout.
 	const SaveState &state = controller.state;
@@ -430,6 +433,7 @@ void MainWindow::on_game_clock_changed() {
 }
 
 void MainWindow::on_yellow_card_time_changed() {
+	std::lock_guard<std::recursive_mutex> lock(controller.mutex);
 	const SSL_Referee &ref = controller.state.referee();
 	const SSL_Referee::TeamInfo *teams[2] = { &ref.yellow(), &ref.blue() };
 	Gtk::Button *buttons[2] = { &yellow_yellowcard_but, &blue_yellowcard_but };
@@ -474,6 +478,7 @@ void MainWindow::on_other_changed() {
 	update_sensitivities();
 
 	// Grab the state.
+	std::lock_guard<std::recursive_mutex> lock(controller.mutex);
 	const SaveState &state = controller.state;
 	const SSL_Referee &ref = state.referee();
 
@@ -615,6 +620,7 @@ void MainWindow::on_toggle_pause_game() {
 }
 
 void MainWindow::update_sensitivities() {
+	std::lock_guard<std::recursive_mutex> lock(controller.mutex);
 	// Extract the things we might need.
 	const SaveState &ss = controller.state;
 	const SSL_Referee &ref = ss.referee();
@@ -0,0 +1,75 @@
+#include "mappedfile.h"
+#include "exception.h"
+#include <glibmm/convert.h>
+#include <glibmm/ustring.h>
+
+#ifndef WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+MappedFile::MappedFile(const std::string &filename) {
+	const std::string &message = Glib::locale_from_utf8(Glib::ustring::compose(u8"Error reading file %1", Glib::filename_to_utf8(filename)));
+#ifndef WIN32
+	map = nullptr;
+	length = 0;
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw SystemError(message);
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int rc = errno;
+		close(fd);
+		throw SystemError(message, rc);
+	}
+	length = static_cast<std::size_t>(st.st_size);
+	if (length) {
+		map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			int rc = errno;
+			map = nullptr;
+			close(fd);
+			throw SystemError(message, rc);
+		}
+	}
+	// The mapping stays valid after the descriptor is closed.
+	close(fd);
+#else
+	std::ifstream ifs;
+	ifs.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+	ifs.open(filename, std::ios_base::in | std::ios_base::binary);
+	ifs.exceptions(std::ios_base::badbit);
+	contents.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef WIN32
+	if (map) {
+		munmap(map, length);
+	}
+#endif
+}
+
+const char *MappedFile::data() const {
+#ifndef WIN32
+	return static_cast<const char *>(map);
+#else
+	return contents.data();
+#endif
+}
+
+std::size_t MappedFile::size() const {
+#ifndef WIN32
+	return length;
+#else
+	return contents.size();
+#endif
+}
@@ -0,0 +1,27 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "noncopyable.h"
+#include <cstddef>
+#include <string>
+
+// The contents of a file, read-only, mapped into memory where the platform allows so that even hours of recording can be jumped around in without reading it all.
+// Elsewhere, the file is read into memory instead.
+class MappedFile : public NonCopyable {
+	public:
+		explicit MappedFile(const std::string &filename);
+		~MappedFile();
+
+		const char *data() const;
+		std::size_t size() const;
+
+	private:
+#ifndef WIN32
+		void *map;
+		std::size_t length;
+#else
+		std::string contents;
+#endif
+};
+
+#endif
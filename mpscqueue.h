@@ -0,0 +1,115 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include "noncopyable.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A bounded lock-free queue passing items from any number of producer threads to exactly one consumer thread.
+// Each slot carries a sequence number saying whose turn it is, so producers claim slots with a single compare-and-swap and never wait on one another.
+template<typename T> class MPSCQueue : public NonCopyable {
+	public:
+		// Creates a queue holding at least capacity items; the capacity is rounded up to a power of two.
+		explicit MPSCQueue(std::size_t capacity);
+
+		std::size_t capacity() const;
+
+		// Returns roughly how many items are queued; exact only when no other thread is pushing or popping.
+		std::size_t size() const;
+
+		// Adds an item; may be called by any thread.
+		// Returns false, leaving the item untouched, if the queue is full.
+		bool push(T &&item);
+
+		// Removes the oldest item; called only by the consumer.
+		// Returns false if the queue is empty, or if the oldest slot has been claimed but not yet filled.
+		bool pop(T &item);
+
+	private:
+		struct Slot {
+			std::atomic<std::size_t> sequence;
+			T item;
+		};
+
+		std::vector<Slot> slots;
+		const std::size_t mask;
+
+		// The two ends live on separate cache lines so the producers and consumer do not contend for one.
+		// As in SPSCQueue, padding rather than alignas keeps them apart, so the queue stays safe to allocate with plain new.
+		std::atomic<std::size_t> head;
+		char head_padding[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> tail;
+
+		static std::size_t round_up(std::size_t capacity);
+};
+
+
+
+template<typename T> MPSCQueue<T>::MPSCQueue(std::size_t capacity) :
+		slots(round_up(capacity)),
+		mask(slots.size() - 1),
+		head(0),
+		tail(0) {
+	for (std::size_t i = 0; i < slots.size(); ++i) {
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template<typename T> std::size_t MPSCQueue<T>::capacity() const {
+	return slots.size();
+}
+
+template<typename T> std::size_t MPSCQueue<T>::size() const {
+	std::size_t h = head.load(std::memory_order_relaxed);
+	std::size_t t = tail.load(std::memory_order_relaxed);
+	return t > h ? t - h : 0;
+}
+
+template<typename T> bool MPSCQueue<T>::push(T &&item) {
+	// A slot is free for position pos when its sequence equals pos, and still holds the item from one lap ago when it is behind.
+	std::size_t pos = tail.load(std::memory_order_relaxed);
+	Slot *slot;
+	for (;;) {
+		slot = &slots[pos & mask];
+		std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+		if (diff == 0) {
+			if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+	slot->item = std::move(item);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T> bool MPSCQueue<T>::pop(T &item) {
+	std::size_t pos = head.load(std::memory_order_relaxed);
+	Slot &slot = slots[pos & mask];
+	if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+		return false;
+	}
+	item = std::move(slot.item);
+	// Hand the slot back to producers for its next lap.
+	slot.sequence.store(pos + slots.size(), std::memory_order_release);
+	head.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
+
+template<typename T> std::size_t MPSCQueue<T>::round_up(std::size_t capacity) {
+	std::size_t result = 1;
+	while (result < capacity) {
+		result <<= 1;
+	}
+	return result;
+}
+
+#endif
@@ -2,27 +2,47 @@
 #include "configuration.h"
 #include "referee.pb.h"
 #include "savestate.pb.h"
-#include <chrono>
-#include <ctime>
-#include <string>
-#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 
-ProtobufPublisher::ProtobufPublisher(const Configuration &configuration, Logger &logger) : bcast(logger, configuration.address, configuration.protobuf_port, configuration.interface) {
+namespace {
+	// Room at the front of the buffer for the packet timestamp field: a one-byte tag followed by a varint of up to ten bytes.
+	const std::size_t TIMESTAMP_HEADROOM = 11;
+
+	// The buffer is sized up front to hold any ordinary packet, so that it never needs to grow while the game runs.
+	const std::size_t INITIAL_BODY_CAPACITY = 1024;
+}
+
+ProtobufPublisher::ProtobufPublisher(const Configuration &configuration, UDPTransmitter &transmitter) : bcast(transmitter, configuration.address, configuration.protobuf_port), buffer(TIMESTAMP_HEADROOM + INITIAL_BODY_CAPACITY), body_size(0) {
 }
 
-void ProtobufPublisher::publish(SaveState &state) {
-	// Shove in the packet timestamp.
-	std::chrono::microseconds diff = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(0));
-	state.mutable_referee()->set_packet_timestamp(static_cast<uint64_t>(diff.count()));
+void ProtobufPublisher::publish(SaveState &state, unsigned int changes) {
+	// Pick up the packet timestamp the controller stamped for this publish.
+	SSL_Referee &ref = *state.mutable_referee();
+	uint64_t timestamp = ref.packet_timestamp();
 
-	// Serialize the packet.
-	std::string packet;
-	{
-		google::protobuf::io::StringOutputStream sos(&packet);
-		state.referee().SerializeToZeroCopyStream(&sos);
+	// Serialize everything except the timestamp directly into the buffer after the headroom, but only if something changed since the last time.
+	// The packet is serialized from the controller’s own referee message, so no temporary message is ever built and a protobuf Arena would have nothing to hold.
+	if (changes || !body_size) {
+		ref.clear_packet_timestamp();
+		body_size = ref.ByteSizeLong();
+		if (buffer.size() < TIMESTAMP_HEADROOM + body_size) {
+			buffer.resize(TIMESTAMP_HEADROOM + body_size);
+		}
+		ref.SerializeWithCachedSizesToArray(&buffer[TIMESTAMP_HEADROOM]);
 	}
+	ref.set_packet_timestamp(timestamp);
+
+	// Encode the timestamp field so that it ends exactly where the body starts.
+	// Protobuf parsers accept fields in any order, so this decodes exactly like a freshly serialized message.
+	uint8_t prefix[TIMESTAMP_HEADROOM];
+	uint8_t *prefix_end = google::protobuf::io::CodedOutputStream::WriteTagToArray(google::protobuf::internal::WireFormatLite::MakeTag(SSL_Referee::kPacketTimestampFieldNumber, google::protobuf::internal::WireFormatLite::WIRETYPE_VARINT), prefix);
+	prefix_end = google::protobuf::io::CodedOutputStream::WriteVarint64ToArray(timestamp, prefix_end);
+	std::size_t prefix_size = static_cast<std::size_t>(prefix_end - prefix);
+	uint8_t *packet = &buffer[TIMESTAMP_HEADROOM - prefix_size];
+	std::memcpy(packet, prefix, prefix_size);
 
 	// Send the packet.
-	bcast.send(packet.data(), packet.size());
+	bcast.send(packet, prefix_size + body_size);
 }
-
@@ -4,17 +4,22 @@
 #include "noncopyable.h"
 #include "publisher.h"
 #include "udpbroadcast.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 class Configuration;
-class Logger;
+class UDPTransmitter;
 
 class ProtobufPublisher : public NonCopyable, public Publisher {
 	public:
-		ProtobufPublisher(const Configuration &configuration, Logger &logger);
-		void publish(SaveState &state);
+		ProtobufPublisher(const Configuration &configuration, UDPTransmitter &transmitter);
+		void publish(SaveState &state, unsigned int changes);
 
 	private:
 		UDPBroadcast bcast;
+		std::vector<uint8_t> buffer;
+		std::size_t body_size;
 };
 
 #endif
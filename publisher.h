@@ -5,7 +5,19 @@ class SaveState;
 
 class Publisher {
 	public:
-		virtual void publish(SaveState &state) = 0;
+		// Bits describing which parts of the state changed since the previous publish.
+		// The packet timestamp is not tracked, as every publish sets it anew.
+		enum Change {
+			CHANGE_CLOCKS = 1 << 0,
+			CHANGE_COMMAND = 1 << 1,
+			CHANGE_STAGE = 1 << 2,
+			CHANGE_CARDS = 1 << 3,
+			CHANGE_OTHER = 1 << 4,
+			CHANGE_ALL = CHANGE_CLOCKS | CHANGE_COMMAND | CHANGE_STAGE | CHANGE_CARDS | CHANGE_OTHER,
+		};
+
+		// Sends the state; the packet timestamp in the state has already been set to the time of this publish.
+		virtual void publish(SaveState &state, unsigned int changes) = 0;
 };
 
 #endif
@@ -0,0 +1,199 @@
+#include "rconsession.h"
+#include "gamecontroller.h"
+#include "logger.h"
+#include "rcon.pb.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <glibmm/ustring.h>
+
+#if defined(WIN32)
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+namespace {
+	const unsigned int MAX_PACKET_SIZE = 4096;
+
+	// Large enough for one incomplete frame left over from the last read plus one more whole frame.
+	const std::size_t RECEIVE_BUFFER_SIZE = 2 * (sizeof(uint32_t) + MAX_PACKET_SIZE);
+
+	// How many output budgets a subscriber may fall behind on updates before it is dropped.
+	const std::size_t OVERFLOW_FACTOR = 4;
+}
+
+
+
+RConSession::RConSession(Logger &logger, std::size_t output_budget) :
+		input(RECEIVE_BUFFER_SIZE),
+		paused(false),
+		subscribed(false),
+		subscription_id(0),
+		update_sequence(0),
+		logger(logger),
+		output_budget(output_budget),
+		front_length(0) {
+}
+
+RConSession::Decode RConSession::decode(SSL_RefereeRemoteControlRequest &request) {
+	if (input.size() < sizeof(uint32_t)) {
+		return Decode::INCOMPLETE;
+	}
+	uint32_t length;
+	input.peek(0, &length, sizeof(length));
+	length = ntohl(length);
+	if (length > MAX_PACKET_SIZE) {
+		logger.write(Glib::ustring::compose(u8"Packet size %1 too large", length));
+		return Decode::MALFORMED;
+	}
+	if (input.size() - sizeof(length) < length) {
+		return Decode::INCOMPLETE;
+	}
+	// Decode the body where it lies in the ring; only a body that wraps around the end is copied out first.
+	if (!request.ParseFromArray(input.contiguous(sizeof(length), length, wrap_scratch), static_cast<int>(length))) {
+		logger.write(u8"Protobuf parsing failed");
+		return Decode::MALFORMED;
+	}
+	front_length = sizeof(length) + length;
+	return Decode::REQUEST;
+}
+
+void RConSession::consume() {
+	input.consume(front_length);
+	front_length = 0;
+}
+
+void RConSession::update_subscription(const SSL_RefereeRemoteControlRequest &request, const SSL_RefereeRemoteControlReply &reply, uint64_t sequence) {
+	if (request.has_subscribe() && reply.outcome() == SSL_RefereeRemoteControlReply::OK) {
+		subscribed = request.subscribe();
+		subscription_id = request.message_id();
+		update_sequence = sequence;
+	}
+}
+
+void RConSession::queue_update(uint64_t sequence, const SSL_Referee &update) {
+	if (!subscribed || sequence <= update_sequence) {
+		return;
+	}
+	SSL_RefereeRemoteControlReply reply;
+	reply.set_message_id(subscription_id);
+	reply.set_outcome(SSL_RefereeRemoteControlReply::OK);
+	reply.mutable_update()->CopyFrom(update);
+	queue_reply(reply);
+	update_sequence = sequence;
+}
+
+bool RConSession::output_blocked(std::size_t unsent) const {
+	return unsent >= output_budget;
+}
+
+bool RConSession::output_overflowed(std::size_t unsent) const {
+	return unsent > OVERFLOW_FACTOR * output_budget;
+}
+
+void RConSession::queue_reply(const SSL_RefereeRemoteControlReply &reply) {
+	std::size_t size = reply.ByteSizeLong();
+	if (size > std::numeric_limits<uint32_t>::max()) {
+		throw std::runtime_error("Protobuf error serializing remote control reply: too large to frame!");
+	}
+	uint32_t size_be = htonl(static_cast<uint32_t>(size));
+	std::size_t offset = output.size();
+	output.resize(offset + sizeof(size_be) + size);
+	std::memcpy(&output[offset], &size_be, sizeof(size_be));
+	reply.SerializeWithCachedSizesToArray(&output[offset + sizeof(size_be)]);
+}
+
+
+
+namespace {
+	// Carries out a request with the controller's lock held, stopping at the first check that fails.
+	void apply_request(GameController &controller, const std::set<SSL_Referee_Command> &commands_on_hold, const SSL_RefereeRemoteControlRequest &request, SSL_RefereeRemoteControlReply &reply, bool &delay, uint64_t &update_sequence) {
+		reply.set_message_id(request.message_id());
+		reply.set_outcome(SSL_RefereeRemoteControlReply::OK);
+		delay = false;
+		update_sequence = 0;
+
+		if (request.has_last_command_counter()) {
+			if (request.last_command_counter() != controller.state.referee().command_counter()) {
+				reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_COMMAND_COUNTER);
+				return;
+			}
+		}
+
+		unsigned int actions = request.has_stage() + request.has_command() + request.has_card();
+		if (actions > 1) {
+			reply.set_outcome(SSL_RefereeRemoteControlReply::MULTIPLE_ACTIONS);
+			return;
+		}
+
+		if ((request.has_designated_position() && !request.has_command())
+		    || (request.has_command() && (request.has_designated_position() != controller.command_needs_designated_position(request.command())))) {
+			reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_DESIGNATED_POSITION);
+			return;
+		}
+
+		if (request.has_advance_time()) {
+			if (controller.is_virtual_time()) {
+				controller.advance_time(std::chrono::microseconds(request.advance_time()));
+			} else {
+				reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_ADVANCE_TIME);
+				return;
+			}
+		}
+
+		if (request.has_stage()) {
+			if (controller.can_enter_stage(request.stage())) {
+				controller.enter_stage(request.stage());
+			} else {
+				reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_STAGE);
+				return;
+			}
+		} else if (request.has_command()) {
+			if (controller.can_set_command(request.command())) {
+				if(commands_on_hold.find(request.command()) != commands_on_hold.end()) {
+					delay = true;
+					controller.logger.write("Pause incoming command");
+					return;
+				}
+				controller.set_command(request.command(), request.designated_position().x(), request.designated_position().y(), false);
+			} else {
+				reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_COMMAND);
+				return;
+			}
+		} else if (request.has_card()) {
+			if (controller.can_issue_card()) {
+				SaveState::Team team = request.card().team() == SSL_RefereeRemoteControlRequest::CardInfo::TEAM_YELLOW ? SaveState::TEAM_YELLOW : SaveState::TEAM_BLUE;
+				if (request.card().type() == SSL_RefereeRemoteControlRequest::CardInfo::CARD_YELLOW) {
+					controller.yellow_card(team);
+				} else {
+					controller.red_card(team);
+				}
+			} else {
+				reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_CARD);
+				return;
+			}
+		}
+
+		if(request.has_gameevent()) {
+			controller.set_game_event(&request.gameevent());
+		}
+
+		if (request.subscribe()) {
+			// Start the subscriber from the last published packet, under the same lock that orders the deltas, so it misses none and sees none twice.
+			reply.mutable_update()->CopyFrom(controller.state_feed.snapshot());
+			update_sequence = controller.state_feed.sequence();
+		}
+	}
+}
+
+void execute_rcon_request(GameController &controller, const std::set<SSL_Referee_Command> &commands_on_hold, const SSL_RefereeRemoteControlRequest &request, SSL_RefereeRemoteControlReply &reply, bool &delay, uint64_t &update_sequence) {
+	// Hold the lock throughout so the tick thread cannot change the state between checking and acting on a request.
+	std::lock_guard<std::recursive_mutex> lock(controller.mutex);
+	std::chrono::microseconds started = controller.event_log.now();
+	apply_request(controller, commands_on_hold, request, reply, delay, update_sequence);
+	controller.event_log.remote_control(started, request, reply, delay, controller.state.referee().command_counter());
+}
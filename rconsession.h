@@ -0,0 +1,80 @@
+#ifndef RCONSESSION_H
+#define RCONSESSION_H
+
+#include "noncopyable.h"
+#include "ringbuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+#include <referee.pb.h>
+
+class GameController;
+class Logger;
+class SSL_RefereeRemoteControlRequest;
+class SSL_RefereeRemoteControlReply;
+
+// The remote control protocol on one connection, independent of how its bytes are carried.
+// The transport reads into input and writes out output; the session decodes requests from the one and frames replies into the other.
+class RConSession : public NonCopyable {
+	public:
+		enum class Decode {
+			// The front of input does not yet hold a whole request.
+			INCOMPLETE,
+			// A request was decoded.
+			REQUEST,
+			// The front of input is not a valid request, and the connection should be dropped.
+			MALFORMED,
+		};
+
+		// The bytes received and not yet consumed.
+		RingBuffer input;
+
+		// Framed replies not yet taken by the transport.
+		std::vector<unsigned char> output;
+
+		// Whether the request at the front of input is waiting for its command to come off hold.
+		bool paused;
+
+		// Whether the client subscribed to state updates, the message ID of the request that subscribed, and the sequence number of the last update it has.
+		bool subscribed;
+		uint32_t subscription_id;
+		uint64_t update_sequence;
+
+		// The output budget is how many bytes of replies and updates may wait for the client before it counts as falling behind.
+		RConSession(Logger &logger, std::size_t output_budget);
+
+		// Decodes the request at the front of input, if it is all there, without consuming it.
+		Decode decode(SSL_RefereeRemoteControlRequest &request);
+
+		// Drops the request last decoded from the front of input.
+		void consume();
+
+		// Records a subscribe or unsubscribe request once its reply shows it was accepted, given the sequence number execute_rcon_request returned.
+		void update_subscription(const SSL_RefereeRemoteControlRequest &request, const SSL_RefereeRemoteControlReply &reply, uint64_t sequence);
+
+		// Frames a state update for the client, unless it is not subscribed or already has it.
+		void queue_update(uint64_t sequence, const SSL_Referee &update);
+
+		// Returns whether the client has so many bytes, unsent, still to read that no more of its requests should run until it catches up.
+		bool output_blocked(std::size_t unsent) const;
+
+		// Returns whether it has fallen so far behind that it should be dropped; only updates, which cannot be held back, take it this far.
+		bool output_overflowed(std::size_t unsent) const;
+
+		// Frames a reply, length prefix and body together, at the end of output, so that the whole frame goes out in a single write.
+		void queue_reply(const SSL_RefereeRemoteControlReply &reply);
+
+	private:
+		Logger &logger;
+		const std::size_t output_budget;
+		std::vector<unsigned char> wrap_scratch;
+		std::size_t front_length;
+};
+
+// Applies a request to the game, taking the controller's lock, and fills in the reply.
+// If the request carries a command on hold, it is not applied and delay is set, so that it can be run again once the hold is lifted.
+// If the request subscribes, the reply carries the state to start from and update_sequence is set to the sequence number of the last update it includes.
+void execute_rcon_request(GameController &controller, const std::set<SSL_Referee_Command> &commands_on_hold, const SSL_RefereeRemoteControlRequest &request, SSL_RefereeRemoteControlReply &reply, bool &delay, uint64_t &update_sequence);
+
+#endif
@@ -3,7 +3,9 @@
 #include "gamecontroller.h"
 #include "logger.h"
 #include "rcon.pb.h"
-#include <cstring>
+#include "rconthread.h"
+#include <mutex>
+#include <utility>
 #include <giomm/error.h>
 #include <giomm/inetsocketaddress.h>
 #include <giomm/socketaddress.h>
@@ -12,15 +14,12 @@
 #if defined(WIN32)
 #include <winsock2.h>
 #else
-#include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #endif
 
 namespace {
-	const unsigned int MAX_PACKET_SIZE = 4096;
-
 	Glib::ustring format_address(const Glib::RefPtr<Gio::SocketAddress> &address) {
 		const Glib::RefPtr<Gio::InetSocketAddress> &inet_address = Glib::RefPtr<Gio::InetSocketAddress>::cast_dynamic(address);
 		if (inet_address) {
@@ -35,10 +34,30 @@ namespace {
 
 RConServer::RConServer(GameController &controller) :
 		controller(controller),
-		listener(Gio::SocketService::create()),
-		connections(),
+		connections(controller.configuration.rcon_max_connections),
 		logger(controller.logger)
 {
+	if (controller.configuration.rcon_thread) {
+#ifdef __linux__
+		if (controller.has_tick_tasks()) {
+			thread_server.reset(new RConThreadServer(controller, commands_on_hold));
+			logger.write("Start listening for remote control commands on a dedicated thread");
+			return;
+		}
+		logger.write(u8"Warning: remote control runs on the main loop in virtual time, as there is no tick thread to run requests on");
+#else
+		logger.write(u8"Warning: a dedicated remote control thread is only supported on Linux");
+#endif
+	}
+
+	// State updates for subscribers arrive on whichever thread publishes, so hand them over to the main loop.
+	updates_dispatcher.connect(sigc::mem_fun(this, &RConServer::on_updates_ready));
+	{
+		std::lock_guard<std::recursive_mutex> lock(controller.mutex);
+		feed_connection = controller.state_feed.signal_delta.connect(sigc::mem_fun(this, &RConServer::on_state_delta));
+	}
+
+	listener = Gio::SocketService::create();
 	listener->add_inet_port(controller.configuration.rcon_port);
 	listener->signal_incoming().connect(sigc::mem_fun(this, &RConServer::on_incoming));
 	listener->start();
@@ -46,202 +65,226 @@ RConServer::RConServer(GameController &controller) :
 }
 
 RConServer::~RConServer() {
-	listener->stop();
-	listener->close();
+	{
+		std::lock_guard<std::recursive_mutex> lock(controller.mutex);
+		feed_connection.disconnect();
+	}
+	if (listener) {
+		listener->stop();
+		listener->close();
+	}
 	logger.write("Stop listening for remote control commands");
 }
 
+void RConServer::on_state_delta(uint64_t sequence, const SSL_Referee &delta) {
+	std::lock_guard<std::mutex> lock(updates_mutex);
+	bool wake = pending_updates.empty();
+	pending_updates.emplace_back(sequence, delta);
+	if (wake) {
+		updates_dispatcher.emit();
+	}
+}
+
+void RConServer::on_updates_ready() {
+	std::vector<std::pair<uint64_t, SSL_Referee>> updates;
+	{
+		std::lock_guard<std::mutex> lock(updates_mutex);
+		updates.swap(pending_updates);
+	}
+	for (uint32_t slot = 0; slot < connections.capacity(); ++slot) {
+		Connection *conn = connections.get(slot);
+		if (conn && !conn->dead()) {
+			conn->queue_updates(updates);
+		}
+	}
+}
+
 bool RConServer::on_incoming(const Glib::RefPtr<Gio::SocketConnection> &sock, const Glib::RefPtr<Glib::Object> &) {
-	connections.emplace_back(*this, sock);
-	std::list<Connection>::iterator iterator = connections.end();
-	--iterator;
-	iterator->set_connection_list_iterator(iterator);
+	if (connections.full()) {
+		logger.write(Glib::ustring::compose(u8"Refusing remote control connection from %1: already at the limit of %2 connections", format_address(sock->get_remote_address()), connections.capacity()));
+		sock->close();
+		return false;
+	}
+	connections.emplace(*this, sock);
 	return false;
 }
 
 
 
-RConServer::Connection::Connection(RConServer &server, const Glib::RefPtr<Gio::SocketConnection> &sock) :
+RConServer::Connection::Connection(SlabHandle handle, RConServer &server, const Glib::RefPtr<Gio::SocketConnection> &sock) :
+		handle(handle),
 		server(server),
-		sock(sock)
+		sock(sock),
+		cancellable(Gio::Cancellable::create()),
+		session(server.logger, server.controller.configuration.rcon_output_budget)
 {
 	server.controller.logger.write(Glib::ustring::compose(u8"Accepted remote control connection from %1", format_address(sock->get_remote_address())));
 	if (!sock->get_socket()->set_option(IPPROTO_TCP, TCP_NODELAY, 1)) {
 		server.controller.logger.write(u8"Warning: unable to set TCP_NODELAY option");
 	}
-	paused = false;
-	start_read_length();
+	reading = false;
+	writing = false;
+	closing = false;
+	write_offset = 0;
+	start_read();
 }
 
 RConServer::Connection::~Connection() {
 	server.controller.logger.write(Glib::ustring::compose(u8"End remote control connection from %1", format_address(sock->get_remote_address())));
-	sock->close();
-}
-
-void RConServer::Connection::set_connection_list_iterator(std::list<Connection>::iterator iter) {
-	connection_list_iterator = iter;
+	// Operations are only still pending if the whole server is going away; the socket then closes once GIO drops its last reference.
+	cancellable->cancel();
+	try {
+		sock->close();
+	} catch (const Gio::Error &) {
+	}
 }
 
-void RConServer::Connection::start_read_length() {
-	start_read_fully(&length, sizeof(length), sigc::mem_fun(this, &RConServer::Connection::finished_read_length));
+void RConServer::Connection::close() {
+	closing = true;
+	cancellable->cancel();
+	erase_if_idle();
 }
 
-void RConServer::Connection::finished_read_length(bool ok) {
-	if (ok) {
-		length = ntohl(length);
-		if (length <= MAX_PACKET_SIZE) {
-			buffer.resize(length);
-			start_read_fully(&buffer[0], buffer.size(), sigc::mem_fun(this, &RConServer::Connection::finished_read_data));
-		} else {
-			server.controller.logger.write(Glib::ustring::compose(u8"Packet size %1 too large", length));
-			server.connections.erase(connection_list_iterator);
-		}
-	} else {
-		server.connections.erase(connection_list_iterator);
+void RConServer::Connection::erase_if_idle() {
+	if (!reading && !writing) {
+		server.connections.erase(handle);
 	}
 }
 
-void RConServer::Connection::finished_read_data(bool ok) {
-	if (ok) {
-		SSL_RefereeRemoteControlRequest request;
-		if (request.ParseFromArray(&buffer[0], static_cast<int>(buffer.size()))) {
-			SSL_RefereeRemoteControlReply reply;
-			bool delayRequest;
-			execute_request(request, reply, delayRequest);
-			if(delayRequest) {
-				paused = true;
-				return;
-			}
-			length = reply.ByteSize();
-			buffer.resize(sizeof(length) + length);
-			reply.SerializeWithCachedSizesToArray(&buffer[sizeof(length)]);
-			length = htonl(length);
-			std::memcpy(&buffer[0], &length, sizeof(length));
-			start_write_fully(&buffer[0], buffer.size(), sigc::mem_fun(this, &RConServer::Connection::finished_write_reply));
-		} else {
-			server.controller.logger.write(u8"Protobuf parsing failed");
-			server.connections.erase(connection_list_iterator);
-		}
-	} else {
-		server.connections.erase(connection_list_iterator);
-	}
+void RConServer::Connection::start_read() {
+	// The ring holds at most one incomplete frame after processing, so there is always free space to read into; read as much of it as the socket has.
+	reading = true;
+	sock->get_input_stream()->read_async(session.input.write_pointer(), session.input.write_length(), sigc::mem_fun(this, &RConServer::Connection::finished_read), cancellable);
 }
 
-void RConServer::Connection::finished_write_reply(bool ok) {
-	if (ok) {
-		start_read_length();
-	} else {
-		server.connections.erase(connection_list_iterator);
+void RConServer::Connection::finished_read(Glib::RefPtr<Gio::AsyncResult> &result) {
+	gssize bytes_read;
+	try {
+		bytes_read = sock->get_input_stream()->read_finish(result);
+	} catch (const Gio::Error &) {
+		bytes_read = -1;
 	}
-}
-
-void RConServer::Connection::execute_request(const SSL_RefereeRemoteControlRequest &request, SSL_RefereeRemoteControlReply &reply, bool &delayRequest) {
-	reply.set_message_id(request.message_id());
-	reply.set_outcome(SSL_RefereeRemoteControlReply::OK);
-	delayRequest = false;
-
-	if (request.has_last_command_counter()) {
-		if (request.last_command_counter() != server.controller.state.referee().command_counter()) {
-			reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_COMMAND_COUNTER);
-			return;
-		}
+	reading = false;
+	if (closing) {
+		erase_if_idle();
+		return;
 	}
-
-	unsigned int actions = request.has_stage() + request.has_command() + request.has_card();
-	if (actions > 1) {
-		reply.set_outcome(SSL_RefereeRemoteControlReply::MULTIPLE_ACTIONS);
+	if (bytes_read <= 0) {
+		close();
 		return;
 	}
+	session.input.commit(static_cast<std::size_t>(bytes_read));
+	pump();
+}
 
-	if ((request.has_designated_position() && !request.has_command())
-	    || (request.has_command() && (request.has_designated_position() != server.controller.command_needs_designated_position(request.command())))) {
-		reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_DESIGNATED_POSITION);
+void RConServer::Connection::pump() {
+	if (!process_frames()) {
 		return;
 	}
+	// Stop reading while the client is not reading its replies; the kernel buffers then fill and TCP pushes back on the client.
+	if (!reading && !session.paused && !session.output_blocked(unsent())) {
+		start_read();
+	}
+}
 
-	if (request.has_stage()) {
-		if (server.controller.can_enter_stage(request.stage())) {
-			server.controller.enter_stage(request.stage());
-		} else {
-			reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_STAGE);
-			return;
-		}
-	} else if (request.has_command()) {
-		if (server.controller.can_set_command(request.command())) {
-			if(server.commands_on_hold.find(request.command()) != server.commands_on_hold.end()) {
-				delayRequest = true;
-				server.logger.write("Pause incoming command");
-				return;
-			}
-			server.controller.set_command(request.command(), request.designated_position().x(), request.designated_position().y(), false);
-		} else {
-			reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_COMMAND);
-			return;
+std::size_t RConServer::Connection::unsent() const {
+	return session.output.size() + (writing ? write_active.size() - write_offset : 0);
+}
+
+bool RConServer::Connection::process_frames() {
+	// Execute every complete request in the buffer in order, so a client that pipelines several requests gets all of them handled in one pass.
+	while (!session.paused && !session.output_blocked(unsent())) {
+		SSL_RefereeRemoteControlRequest request;
+		RConSession::Decode result = session.decode(request);
+		if (result == RConSession::Decode::INCOMPLETE) {
+			break;
+		} else if (result == RConSession::Decode::MALFORMED) {
+			close();
+			return false;
 		}
-	} else if (request.has_card()) {
-		if (server.controller.can_issue_card()) {
-			SaveState::Team team = request.card().team() == SSL_RefereeRemoteControlRequest::CardInfo::TEAM_YELLOW ? SaveState::TEAM_YELLOW : SaveState::TEAM_BLUE;
-			if (request.card().type() == SSL_RefereeRemoteControlRequest::CardInfo::CARD_YELLOW) {
-				server.controller.yellow_card(team);
-			} else {
-				server.controller.red_card(team);
-			}
-		} else {
-			reply.set_outcome(SSL_RefereeRemoteControlReply::BAD_CARD);
-			return;
+		SSL_RefereeRemoteControlReply reply;
+		bool delay;
+		uint64_t update_sequence;
+		execute_rcon_request(server.controller, server.commands_on_hold, request, reply, delay, update_sequence);
+		if (delay) {
+			// Leave the request in the ring and stop here, so that it and everything after it run in order once the hold is lifted.
+			session.paused = true;
+			server.paused_connections.push_back(handle);
+			break;
 		}
+		session.consume();
+		session.update_subscription(request, reply, update_sequence);
+		session.queue_reply(reply);
 	}
 
-	if(request.has_gameevent()) {
-		server.controller.set_game_event(&request.gameevent());
-	}
+	// Send the replies to the whole batch together.
+	start_write();
+	return true;
 }
 
-void RConServer::Connection::start_read_fully(void *buffer, std::size_t length, const sigc::slot<void, bool> &slot) {
-	sock->get_input_stream()->read_async(buffer, length, sigc::bind(sigc::mem_fun(this, &RConServer::Connection::finished_read_fully_partial), buffer, length, slot));
+bool RConServer::Connection::dead() const {
+	return closing;
 }
 
-void RConServer::Connection::finished_read_fully_partial(Glib::RefPtr<Gio::AsyncResult> &result, void *rptr, std::size_t left, const sigc::slot<void, bool> &slot) {
-	try {
-		gssize bytes_read = sock->get_input_stream()->read_finish(result);
-		if (bytes_read > 0) {
-			unsigned char *rptr_ch = static_cast<unsigned char *>(rptr);
-			rptr_ch += bytes_read;
-			left -= bytes_read;
-			if (left) {
-				sock->get_input_stream()->read_async(rptr_ch, left, sigc::bind(sigc::mem_fun(this, &RConServer::Connection::finished_read_fully_partial), rptr_ch, left, slot));
-			} else {
-				slot(true);
-			}
-		} else {
-			slot(false);
-		}
-	} catch (const Gio::Error &) {
-		slot(false);
+void RConServer::Connection::queue_updates(const std::vector<std::pair<uint64_t, SSL_Referee>> &updates) {
+	for (const std::pair<uint64_t, SSL_Referee> &update : updates) {
+		session.queue_update(update.first, update.second);
 	}
+	if (session.output_overflowed(unsent())) {
+		server.logger.write(Glib::ustring::compose(u8"Dropping remote control connection from %1, which has fallen too far behind in reading updates", format_address(sock->get_remote_address())));
+		close();
+		return;
+	}
+	start_write();
+}
+
+bool RConServer::Connection::paused() const {
+	return session.paused;
+}
+
+void RConServer::Connection::resume() {
+	session.paused = false;
+	pump();
 }
 
-void RConServer::Connection::start_write_fully(const void *data, std::size_t length, const sigc::slot<void, bool> &slot) {
-	sock->get_output_stream()->write_async(data, 1, sigc::bind(sigc::mem_fun(this, &RConServer::Connection::finished_write_fully_partial), data, length, slot));
+void RConServer::Connection::start_write() {
+	if (writing || session.output.empty()) {
+		return;
+	}
+
+	// Take everything queued so far; replies queued while this write is in flight are coalesced into the next one.
+	// Swapping rather than copying means both buffers keep their capacity and stop allocating once warmed up.
+	write_active.swap(session.output);
+	session.output.clear();
+	write_offset = 0;
+	writing = true;
+	sock->get_output_stream()->write_async(&write_active[0], write_active.size(), sigc::mem_fun(this, &RConServer::Connection::finished_write), cancellable);
 }
 
-void RConServer::Connection::finished_write_fully_partial(Glib::RefPtr<Gio::AsyncResult> &result, const void *wptr, std::size_t left, const sigc::slot<void, bool> &slot) {
+void RConServer::Connection::finished_write(Glib::RefPtr<Gio::AsyncResult> &result) {
+	gssize bytes_written;
 	try {
-		gssize bytes_written = sock->get_output_stream()->write_finish(result);
-		if (bytes_written > 0) {
-			const unsigned char *wptr_ch = static_cast<const unsigned char *>(wptr);
-			wptr_ch += bytes_written;
-			left -= bytes_written;
-			if (left) {
-				sock->get_output_stream()->write_async(wptr_ch, left, sigc::bind(sigc::mem_fun(this, &RConServer::Connection::finished_write_fully_partial), wptr_ch, left, slot));
-			} else {
-				slot(true);
-			}
-		} else {
-			slot(false);
-		}
+		bytes_written = sock->get_output_stream()->write_finish(result);
 	} catch (const Gio::Error &) {
-		slot(false);
+		bytes_written = -1;
+	}
+	if (closing) {
+		writing = false;
+		erase_if_idle();
+		return;
+	}
+	if (bytes_written <= 0) {
+		writing = false;
+		close();
+		return;
+	}
+	write_offset += static_cast<std::size_t>(bytes_written);
+	if (write_offset < write_active.size()) {
+		sock->get_output_stream()->write_async(&write_active[write_offset], write_active.size() - write_offset, sigc::mem_fun(this, &RConServer::Connection::finished_write), cancellable);
+	} else {
+		writing = false;
+		start_write();
+		pump();
 	}
 }
 
@@ -252,12 +295,20 @@ void RConServer::set_commands_on_hold(const std::set<SSL_Referee_Command> &comma
 		logger.write("Set commands on hold");
 	}
 	commands_on_hold = commands;
-	std::list<Connection>::iterator it;
-	for (it = connections.begin(); it != connections.end(); ++it) {
-		if (it->paused) {
+#ifdef __linux__
+	if (thread_server) {
+		thread_server->set_commands_on_hold(commands);
+		return;
+	}
+#endif
+	// Only connections that were paused need another look, and each goes back on the list if its request is still on hold.
+	std::vector<SlabHandle> paused;
+	paused.swap(paused_connections);
+	for (SlabHandle handle : paused) {
+		Connection *conn = connections.get(handle);
+		if (conn && !conn->dead() && conn->paused()) {
 			logger.write("Resume after unsetting commands on hold");
-			it->paused = false;
-			it->finished_read_data(true);
+			conn->resume();
 		}
 	}
 }
\ No newline at end of file
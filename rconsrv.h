@@ -3,17 +3,27 @@
 
 #include "noncopyable.h"
 #include "logger.h"
-#include <list>
+#include "rconsession.h"
+#include "slab.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <utility>
+#include <vector>
 #include <giomm/asyncresult.h>
+#include <giomm/cancellable.h>
 #include <giomm/socketconnection.h>
 #include <giomm/socketservice.h>
+#include <glibmm/dispatcher.h>
 #include <glibmm/refptr.h>
+#include <sigc++/connection.h>
 #include <sigc++/trackable.h>
 #include <referee.pb.h>
 
 class Configuration;
 class GameController;
+class RConThreadServer;
 class SSL_RefereeRemoteControlRequest;
 class SSL_RefereeRemoteControlReply;
 
@@ -29,38 +39,62 @@ class RConServer : public NonCopyable, public sigc::trackable {
 	private:
 		class Connection : public NonCopyable, public sigc::trackable {
 			public:
-				Connection(RConServer &server, const Glib::RefPtr<Gio::SocketConnection> &sock);
+				Connection(SlabHandle handle, RConServer &server, const Glib::RefPtr<Gio::SocketConnection> &sock);
 				~Connection();
-				bool paused;
 
-				void set_connection_list_iterator(std::list<Connection>::iterator iter);
-				void finished_read_data(bool ok);
+				bool paused() const;
+				bool dead() const;
+				void resume();
+				void queue_updates(const std::vector<std::pair<uint64_t, SSL_Referee>> &updates);
 
 			private:
+				const SlabHandle handle;
 				RConServer &server;
 				Glib::RefPtr<Gio::SocketConnection> sock;
-				std::list<Connection>::iterator connection_list_iterator;
-				uint32_t length;
-				std::vector<unsigned char> buffer;
+				// Cancels the pending read and write together once the connection is torn down.
+				Glib::RefPtr<Gio::Cancellable> cancellable;
+				RConSession session;
+				std::vector<unsigned char> write_active;
+				std::size_t write_offset;
+				bool reading;
+				bool writing;
+				bool closing;
 
-				void start_read_length();
-				void finished_read_length(bool ok);
-				void finished_write_reply(bool ok);
+				// Tears the connection down; the caller must touch nothing afterwards, as the connection may already be destroyed.
+				// The read and write own buffers in this object, so it is only destroyed by whichever of them completes last.
+				void close();
+				void erase_if_idle();
 
-				void execute_request(const SSL_RefereeRemoteControlRequest &request, SSL_RefereeRemoteControlReply &reply, bool &delayRequest);
+				void start_read();
+				void finished_read(Glib::RefPtr<Gio::AsyncResult> &result);
 
-				void start_read_fully(void *buffer, std::size_t length, const sigc::slot<void, bool> &slot);
-				void finished_read_fully_partial(Glib::RefPtr<Gio::AsyncResult> &result, void *rptr, std::size_t left, const sigc::slot<void, bool> &slot);
+				// Runs whatever requests the hold and the output budget allow, then reads more if they allow that too.
+				void pump();
+				std::size_t unsent() const;
+				bool process_frames();
 
-				void start_write_fully(const void *data, std::size_t length, const sigc::slot<void, bool> &slot);
-				void finished_write_fully_partial(Glib::RefPtr<Gio::AsyncResult> &result, const void *wptr, std::size_t left, const sigc::slot<void, bool> &slot);
+				void start_write();
+				void finished_write(Glib::RefPtr<Gio::AsyncResult> &result);
 		};
 
 		GameController &controller;
 		Glib::RefPtr<Gio::SocketService> listener;
-		std::list<Connection> connections;
+		Slab<Connection> connections;
+		// Connections whose next request is on hold; only these need another look when the hold changes.
+		std::vector<SlabHandle> paused_connections;
+		sigc::connection feed_connection;
+		std::mutex updates_mutex;
+		std::vector<std::pair<uint64_t, SSL_Referee>> pending_updates;
+		Glib::Dispatcher updates_dispatcher;
+
+#ifdef __linux__
+		// If configured and available, the remote control thread serves clients instead of the listener and connections above.
+		std::unique_ptr<RConThreadServer> thread_server;
+#endif
 
 		bool on_incoming(const Glib::RefPtr<Gio::SocketConnection> &sock, const Glib::RefPtr<Glib::Object> &);
+		void on_state_delta(uint64_t sequence, const SSL_Referee &delta);
+		void on_updates_ready();
 };
 
 #endif
@@ -0,0 +1,478 @@
+#include "rconthread.h"
+
+#ifdef __linux__
+
+#include "configuration.h"
+#include "exception.h"
+#include "gamecontroller.h"
+#include "logger.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <glibmm/convert.h>
+#include <sigc++/functors/mem_fun.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+namespace {
+	// The most requests in flight between the network and tick threads at once; further ready connections wait their turn.
+	const std::size_t QUEUE_CAPACITY = 256;
+
+	const uint64_t LISTENER_TAG = ~UINT64_C(0);
+	const uint64_t WAKE_TAG = ~UINT64_C(0) - 1;
+
+	uint64_t connection_tag(SlabHandle handle) {
+		return (static_cast<uint64_t>(handle.generation) << 32) | handle.slot;
+	}
+
+	void signal_event(int fd) {
+		uint64_t one = 1;
+		if (write(fd, &one, sizeof(one)) < 0) {
+			// The event counter can only fail to accept a write if it would overflow, in which case it is already readable.
+		}
+	}
+
+	void add_to_epoll(int epoll, int fd, uint32_t events, uint64_t tag) {
+		epoll_event ev;
+		ev.events = events;
+		ev.data.u64 = tag;
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			throw SystemError("Cannot watch descriptor for remote control");
+		}
+	}
+
+	Descriptor listen_on(int family, const sockaddr *address, socklen_t length) {
+		Descriptor sock(socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "Cannot create remote control socket");
+		int one = 1;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (family == AF_INET6) {
+			// Accept IPv4 clients on the same socket, as Gio does.
+			int zero = 0;
+			setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+		}
+		if (bind(sock, address, length) < 0) {
+			throw SystemError("Cannot bind remote control port");
+		}
+		if (listen(sock, SOMAXCONN) < 0) {
+			throw SystemError("Cannot listen on remote control port");
+		}
+		return sock;
+	}
+
+	Descriptor open_listener(uint16_t port) {
+		try {
+			sockaddr_in6 address;
+			std::memset(&address, 0, sizeof(address));
+			address.sin6_family = AF_INET6;
+			address.sin6_addr = in6addr_any;
+			address.sin6_port = htons(port);
+			return listen_on(AF_INET6, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+		} catch (const SystemError &) {
+			if (errno != EAFNOSUPPORT) {
+				throw;
+			}
+		}
+		sockaddr_in address;
+		std::memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(port);
+		return listen_on(AF_INET, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+	}
+
+	Glib::ustring format_address(const sockaddr_storage &address, socklen_t length) {
+		char host[NI_MAXHOST], service[NI_MAXSERV];
+		if (getnameinfo(reinterpret_cast<const sockaddr *>(&address), length, host, sizeof(host), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+			return u8"<Unknown Address>";
+		}
+		// Show IPv4 clients of a dual-stack socket by their plain IPv4 address.
+		const char *host_ptr = host;
+		if (std::strncmp(host_ptr, "::ffff:", 7) == 0 && std::strchr(host_ptr + 7, '.')) {
+			host_ptr += 7;
+		}
+		return Glib::ustring::compose(u8"%1:%2", Glib::locale_to_utf8(host_ptr), Glib::locale_to_utf8(service));
+	}
+}
+
+
+
+RConThreadServer::Connection::Connection(SlabHandle handle, int fd, const Glib::ustring &address, Logger &logger, std::size_t output_budget) :
+		handle(handle),
+		sock(fd, "Cannot accept remote control connection"),
+		address(address),
+		session(logger, output_budget),
+		write_offset(0),
+		events(EPOLLIN),
+		in_flight(false),
+		waiting(false) {
+}
+
+std::size_t RConThreadServer::Connection::unsent() const {
+	return session.output.size() - write_offset;
+}
+
+
+
+RConThreadServer::RConThreadServer(GameController &controller, const std::set<SSL_Referee_Command> &commands_on_hold) :
+		controller(controller),
+		logger(controller.logger),
+		commands_on_hold(commands_on_hold),
+		listener(open_listener(controller.configuration.rcon_port)),
+		epoll(epoll_create1(EPOLL_CLOEXEC), "Cannot create epoll instance for remote control"),
+		wake(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "Cannot create remote control wakeup event"),
+		jobs(QUEUE_CAPACITY),
+		results(QUEUE_CAPACITY),
+		in_flight(0),
+		connections(controller.configuration.rcon_max_connections),
+		submitted(false),
+		stopping(false),
+		resume_requested(false) {
+	if (!controller.has_tick_tasks()) {
+		throw std::logic_error("Remote control thread needs a tick thread to run requests on");
+	}
+	add_to_epoll(epoll, listener, EPOLLIN, LISTENER_TAG);
+	add_to_epoll(epoll, wake, EPOLLIN, WAKE_TAG);
+	{
+		std::lock_guard<std::recursive_mutex> lock(controller.mutex);
+		feed_connection = controller.state_feed.signal_delta.connect(sigc::mem_fun(*this, &RConThreadServer::on_state_delta));
+	}
+	controller.set_tick_task(std::bind(&RConThreadServer::on_tick_task, this));
+	thread = std::thread(&RConThreadServer::run, this);
+}
+
+RConThreadServer::~RConThreadServer() {
+	// Stop the tick thread taking requests and updates before the queues go away, then stop the network thread.
+	{
+		std::lock_guard<std::recursive_mutex> lock(controller.mutex);
+		feed_connection.disconnect();
+	}
+	controller.set_tick_task(std::function<void()>());
+	stopping = true;
+	signal_event(wake);
+	thread.join();
+	for (uint32_t slot = 0; slot < connections.capacity(); ++slot) {
+		if (connections.get(slot)) {
+			close_connection(slot);
+		}
+	}
+}
+
+void RConThreadServer::set_commands_on_hold(const std::set<SSL_Referee_Command> &commands) {
+	{
+		std::lock_guard<std::recursive_mutex> lock(controller.mutex);
+		commands_on_hold = commands;
+	}
+	resume_requested = true;
+	signal_event(wake);
+}
+
+void RConThreadServer::run() {
+	std::array<epoll_event, 64> events;
+	while (!stopping) {
+		int count = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), -1);
+		if (count < 0) {
+			int rc = errno;
+			if (rc == EINTR) {
+				continue;
+			}
+			logger.write(Glib::ustring::compose(u8"Remote control thread stopped: %1", Glib::locale_to_utf8(std::strerror(rc))));
+			return;
+		}
+		submitted = false;
+		for (int i = 0; i < count; ++i) {
+			const epoll_event &ev = events[static_cast<std::size_t>(i)];
+			if (ev.data.u64 == WAKE_TAG) {
+				uint64_t value;
+				if (read(wake, &value, sizeof(value)) < 0) {
+					// Another wakeup already drained the counter.
+				}
+				if (stopping) {
+					return;
+				}
+				// Take the resume request before collecting results, so a request delayed under the old holds is always collected before it is retried.
+				bool resume = resume_requested.exchange(false);
+				collect_results();
+				if (resume) {
+					resume_paused();
+				}
+				deliver_updates();
+			} else if (ev.data.u64 == LISTENER_TAG) {
+				accept_connections();
+			} else {
+				uint32_t slot = static_cast<uint32_t>(ev.data.u64);
+				if (!connections.get(SlabHandle{slot, static_cast<uint32_t>(ev.data.u64 >> 32)})) {
+					// The connection closed earlier in this batch.
+					continue;
+				}
+				if (ev.events & (EPOLLERR | EPOLLHUP)) {
+					close_connection(slot);
+					continue;
+				}
+				if ((ev.events & EPOLLIN) && !receive(slot)) {
+					continue;
+				}
+				if (ev.events & EPOLLOUT) {
+					// Draining output may have lifted the budget, letting the next request go.
+					if (flush(slot) && submit(slot)) {
+						update_events(slot);
+					}
+				}
+			}
+		}
+		// Wake the tick thread once for everything decoded in this pass.
+		if (submitted) {
+			controller.wake_tick_task();
+		}
+	}
+}
+
+void RConThreadServer::accept_connections() {
+	for (;;) {
+		sockaddr_storage address;
+		socklen_t length = sizeof(address);
+		int fd = accept4(listener, reinterpret_cast<sockaddr *>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			int rc = errno;
+			if (rc == EINTR) {
+				continue;
+			} else if (rc != EAGAIN && rc != EWOULDBLOCK) {
+				logger.write(Glib::ustring::compose(u8"Cannot accept remote control connection: %1", Glib::locale_to_utf8(std::strerror(rc))));
+			}
+			return;
+		}
+
+		if (connections.full()) {
+			logger.write(Glib::ustring::compose(u8"Refusing remote control connection from %1: already at the limit of %2 connections", format_address(address, length), connections.capacity()));
+			close(fd);
+			continue;
+		}
+		Connection &conn = *connections.get(connections.emplace(fd, format_address(address, length), logger, controller.configuration.rcon_output_budget));
+		logger.write(Glib::ustring::compose(u8"Accepted remote control connection from %1", conn.address));
+		int one = 1;
+		if (setsockopt(conn.sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+			logger.write(u8"Warning: unable to set TCP_NODELAY option");
+		}
+		add_to_epoll(epoll, conn.sock, conn.events, connection_tag(conn.handle));
+	}
+}
+
+void RConThreadServer::close_connection(uint32_t slot) {
+	// Closing the socket also removes it from the epoll set; any request still in flight is answered into the void.
+	Connection &conn = *connections.get(slot);
+	logger.write(Glib::ustring::compose(u8"End remote control connection from %1", conn.address));
+	connections.erase(conn.handle);
+}
+
+bool RConThreadServer::receive(uint32_t slot) {
+	Connection &conn = *connections.get(slot);
+	while (conn.session.input.space()) {
+		ssize_t rc = recv(conn.sock, conn.session.input.write_pointer(), conn.session.input.write_length(), 0);
+		if (rc > 0) {
+			conn.session.input.commit(static_cast<std::size_t>(rc));
+		} else if (rc < 0 && errno == EINTR) {
+			continue;
+		} else if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			close_connection(slot);
+			return false;
+		}
+	}
+	return submit(slot) && update_events(slot);
+}
+
+bool RConThreadServer::flush(uint32_t slot) {
+	Connection &conn = *connections.get(slot);
+	std::vector<unsigned char> &output = conn.session.output;
+	while (conn.write_offset < output.size()) {
+		ssize_t rc = send(conn.sock, &output[conn.write_offset], output.size() - conn.write_offset, MSG_NOSIGNAL);
+		if (rc > 0) {
+			conn.write_offset += static_cast<std::size_t>(rc);
+		} else if (rc < 0 && errno == EINTR) {
+			continue;
+		} else if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			close_connection(slot);
+			return false;
+		}
+	}
+	if (conn.write_offset == output.size()) {
+		output.clear();
+		conn.write_offset = 0;
+	}
+	return true;
+}
+
+bool RConThreadServer::submit(uint32_t slot) {
+	Connection &conn = *connections.get(slot);
+	if (conn.in_flight || conn.waiting || conn.session.paused || conn.session.output_blocked(conn.unsent())) {
+		return true;
+	}
+	Job job;
+	RConSession::Decode result = conn.session.decode(job.request);
+	if (result == RConSession::Decode::INCOMPLETE) {
+		return true;
+	} else if (result == RConSession::Decode::MALFORMED) {
+		close_connection(slot);
+		return false;
+	}
+	if (in_flight == QUEUE_CAPACITY) {
+		conn.waiting = true;
+		waiting.push_back(conn.handle);
+		return true;
+	}
+	// The request stays in the ring until its reply comes back, so that a held one can be decoded again later.
+	job.connection = conn.handle;
+	jobs.push(std::move(job));
+	++in_flight;
+	conn.in_flight = true;
+	submitted = true;
+	return true;
+}
+
+bool RConThreadServer::update_events(uint32_t slot) {
+	// Stop reading while the ring is full or the client is not reading its replies, and only ask to write while a reply is partly sent.
+	// Once reading stops, the kernel buffers fill and TCP pushes back on the client.
+	Connection &conn = *connections.get(slot);
+	uint32_t events = 0;
+	if (conn.session.input.space() && !conn.session.output_blocked(conn.unsent())) {
+		events |= EPOLLIN;
+	}
+	if (!conn.session.output.empty()) {
+		events |= EPOLLOUT;
+	}
+	if (events != conn.events) {
+		epoll_event ev;
+		ev.events = events;
+		ev.data.u64 = connection_tag(conn.handle);
+		if (epoll_ctl(epoll, EPOLL_CTL_MOD, conn.sock, &ev) < 0) {
+			close_connection(slot);
+			return false;
+		}
+		conn.events = events;
+	}
+	return true;
+}
+
+void RConThreadServer::collect_results() {
+	Result result;
+	while (results.pop(result)) {
+		--in_flight;
+		Connection *conn = connections.get(result.connection);
+		if (!conn) {
+			continue;
+		}
+		conn->in_flight = false;
+		if (result.delayed) {
+			conn->session.paused = true;
+			paused.push_back(result.connection);
+			continue;
+		}
+		conn->session.consume();
+		conn->session.update_subscription(result.request, result.reply, result.update_sequence);
+		conn->session.queue_reply(result.reply);
+		if (flush(result.connection.slot) && submit(result.connection.slot)) {
+			update_events(result.connection.slot);
+		}
+	}
+
+	// Now that there is room in the queues, give waiting connections their turn.
+	std::vector<SlabHandle> ready;
+	ready.swap(waiting);
+	for (SlabHandle handle : ready) {
+		Connection *conn = connections.get(handle);
+		if (conn && conn->waiting) {
+			conn->waiting = false;
+			if (submit(handle.slot)) {
+				update_events(handle.slot);
+			}
+		}
+	}
+	if (submitted) {
+		controller.wake_tick_task();
+		submitted = false;
+	}
+}
+
+void RConThreadServer::resume_paused() {
+	// Only connections that were paused need another look, and each goes back on the list if its request is still on hold.
+	std::vector<SlabHandle> ready;
+	ready.swap(paused);
+	for (SlabHandle handle : ready) {
+		Connection *conn = connections.get(handle);
+		if (conn && conn->session.paused) {
+			logger.write("Resume after unsetting commands on hold");
+			conn->session.paused = false;
+			if (submit(handle.slot)) {
+				update_events(handle.slot);
+			}
+		}
+	}
+}
+
+void RConThreadServer::deliver_updates() {
+	std::vector<std::pair<uint64_t, SSL_Referee>> updates;
+	{
+		std::lock_guard<std::mutex> lock(updates_mutex);
+		updates.swap(pending_updates);
+	}
+	if (updates.empty()) {
+		return;
+	}
+	for (uint32_t slot = 0; slot < connections.capacity(); ++slot) {
+		Connection *conn = connections.get(slot);
+		if (conn && conn->session.subscribed) {
+			for (const std::pair<uint64_t, SSL_Referee> &update : updates) {
+				conn->session.queue_update(update.first, update.second);
+			}
+			if (!flush(slot)) {
+				continue;
+			}
+			if (conn->session.output_overflowed(conn->unsent())) {
+				logger.write(Glib::ustring::compose(u8"Dropping remote control connection from %1, which has fallen too far behind in reading updates", conn->address));
+				close_connection(slot);
+				continue;
+			}
+			update_events(slot);
+		}
+	}
+}
+
+void RConThreadServer::on_state_delta(uint64_t sequence, const SSL_Referee &delta) {
+	// This runs on whichever thread published, with the controller's lock held.
+	{
+		std::lock_guard<std::mutex> lock(updates_mutex);
+		pending_updates.emplace_back(sequence, delta);
+	}
+	signal_event(wake);
+}
+
+void RConThreadServer::on_tick_task() {
+	// This runs on the tick thread with the controller's lock held, so commands_on_hold is safe to read.
+	Job job;
+	bool any = false;
+	while (jobs.pop(job)) {
+		Result result;
+		result.connection = job.connection;
+		execute_rcon_request(controller, commands_on_hold, job.request, result.reply, result.delayed, result.update_sequence);
+		result.request.Swap(&job.request);
+		// This cannot fail: the network thread never has more requests in flight than the queue holds.
+		results.push(std::move(result));
+		any = true;
+	}
+	if (any) {
+		signal_event(wake);
+	}
+}
+
+#endif
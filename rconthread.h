@@ -0,0 +1,113 @@
+#ifndef RCONTHREAD_H
+#define RCONTHREAD_H
+
+#ifdef __linux__
+
+#include "descriptor.h"
+#include "noncopyable.h"
+#include "rcon.pb.h"
+#include "rconsession.h"
+#include "slab.h"
+#include "spscqueue.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <glibmm/ustring.h>
+#include <referee.pb.h>
+#include <sigc++/connection.h>
+
+class GameController;
+class Logger;
+
+// Serves remote control on its own thread with an epoll loop, so requests are read, decoded, and answered without waiting for the main loop.
+// Requests are applied on the tick thread, reached through a pair of lock-free queues, and each reply goes out as soon as its request has been applied.
+// Only available on Linux, and only when the controller has a tick thread to run requests on.
+class RConThreadServer : public NonCopyable {
+	public:
+		RConThreadServer(GameController &controller, const std::set<SSL_Referee_Command> &commands_on_hold);
+		~RConThreadServer();
+
+		// Replaces the commands on hold, then wakes the network thread to retry any connection waiting on one.
+		void set_commands_on_hold(const std::set<SSL_Referee_Command> &commands);
+
+	private:
+		struct Connection : public NonCopyable {
+			const SlabHandle handle;
+			Descriptor sock;
+			Glib::ustring address;
+			RConSession session;
+			std::size_t write_offset;
+			uint32_t events;
+			// A request from this connection is queued for, or being run by, the tick thread; requests go one at a time so holds keep them in order.
+			bool in_flight;
+			// The connection has a request ready but the queues were full.
+			bool waiting;
+
+			Connection(SlabHandle handle, int fd, const Glib::ustring &address, Logger &logger, std::size_t output_budget);
+
+			// Returns how many bytes of output the client has yet to be sent.
+			std::size_t unsent() const;
+		};
+
+		// A request on its way to the tick thread, and its reply on the way back.
+		// The handle names the connection; a result for a connection that has since closed is dropped.
+		struct Job {
+			SlabHandle connection;
+			SSL_RefereeRemoteControlRequest request;
+		};
+
+		struct Result {
+			SlabHandle connection;
+			bool delayed;
+			uint64_t update_sequence;
+			SSL_RefereeRemoteControlRequest request;
+			SSL_RefereeRemoteControlReply reply;
+		};
+
+		GameController &controller;
+		Logger &logger;
+
+		// Only touched with the controller's lock held, as it is read while requests run on the tick thread.
+		std::set<SSL_Referee_Command> commands_on_hold;
+
+		Descriptor listener, epoll, wake;
+		SPSCQueue<Job> jobs;
+		SPSCQueue<Result> results;
+
+		// State updates for subscribers, queued by whichever thread publishes.
+		sigc::connection feed_connection;
+		std::mutex updates_mutex;
+		std::vector<std::pair<uint64_t, SSL_Referee>> pending_updates;
+
+		// Everything below is owned by the network thread once it starts.
+		std::size_t in_flight;
+		Slab<Connection> connections;
+		// Connections with a request ready when the queues were full, and connections whose next request is on hold.
+		std::vector<SlabHandle> waiting, paused;
+		bool submitted;
+
+		std::atomic<bool> stopping, resume_requested;
+		std::thread thread;
+
+		void run();
+		void accept_connections();
+		void close_connection(uint32_t slot);
+		bool receive(uint32_t slot);
+		bool flush(uint32_t slot);
+		bool submit(uint32_t slot);
+		bool update_events(uint32_t slot);
+		void collect_results();
+		void resume_paused();
+		void deliver_updates();
+		void on_tick_task();
+		void on_state_delta(uint64_t sequence, const SSL_Referee &delta);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,311 @@
+#include "configuration.h"
+#include "legacypublisher.h"
+#include "logger.h"
+#include "mappedfile.h"
+#include "protobufpublisher.h"
+#include "publisher.h"
+#include "referee.pb.h"
+#include "savegame.h"
+#include "savestate.pb.h"
+#include "udpbroadcast.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glibmm/convert.h>
+#include <glibmm/exception.h>
+#include <glibmm/init.h>
+#include <glibmm/optioncontext.h>
+#include <glibmm/optionentry.h>
+#include <glibmm/optiongroup.h>
+#include <glibmm/ustring.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/stubs/common.h>
+
+namespace {
+	// Where each journal record lies in the file, and the state of the game once it has been applied, for seeking without replaying.
+	struct IndexEntry {
+		std::size_t offset;
+		uint64_t timestamp;
+		bool snapshot;
+		SSL_Referee::Stage stage;
+		uint32_t command_counter;
+	};
+
+	// The records of one run of the referee box, as the half-open range [begin, end) of the index.
+	struct Session {
+		std::size_t begin, end;
+	};
+
+	// Indexes the journal and splits it into sessions.
+	// A session starts at a snapshot marked as such; any records before the first snapshot are skipped.
+	std::vector<IndexEntry> build_index(const MappedFile &file, std::vector<Session> &sessions) {
+		std::vector<IndexEntry> index;
+		JournalReader reader(file.data(), file.size());
+		SaveState state;
+		SaveJournalRecord record;
+		for (;;) {
+			std::size_t offset = reader.tell();
+			if (!reader.next(record)) {
+				break;
+			}
+			if (!record.has_snapshot() && index.empty()) {
+				continue;
+			}
+			if (index.empty() || (record.has_snapshot() && record.session_start())) {
+				if (!sessions.empty()) {
+					sessions.back().end = index.size();
+				}
+				sessions.push_back(Session{index.size(), 0});
+			}
+			apply_journal_record(state, record);
+			index.push_back(IndexEntry{offset, record.timestamp(), record.has_snapshot(), state.referee().stage(), state.referee().command_counter()});
+		}
+		if (!sessions.empty()) {
+			sessions.back().end = index.size();
+		}
+		return index;
+	}
+
+	// Returns the index of the first record of a session at or after which the game is in the given stage, or has the given command counter, or the start of the session if neither is wanted.
+	std::size_t find_start(const std::vector<IndexEntry> &index, const Session &session, const Glib::ustring &stage_name, int command_counter) {
+		if (!stage_name.empty()) {
+			const google::protobuf::EnumValueDescriptor *value = SSL_Referee::Stage_descriptor()->FindValueByName(stage_name);
+			if (!value) {
+				throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"There is no stage named %1.", stage_name)));
+			}
+			for (std::size_t i = session.begin; i < session.end; ++i) {
+				if (index[i].stage == value->number()) {
+					return i;
+				}
+			}
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"The session never reaches stage %1.", stage_name)));
+		}
+		if (command_counter >= 0) {
+			for (std::size_t i = session.begin; i < session.end; ++i) {
+				if (index[i].command_counter >= static_cast<uint32_t>(command_counter)) {
+					return i;
+				}
+			}
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"The session never reaches command counter %1.", command_counter)));
+		}
+		return session.begin;
+	}
+
+	// Rebuilds the state as of a record by applying everything from the snapshot before it, which is never more than a few dozen records back.
+	void seek(const MappedFile &file, const std::vector<IndexEntry> &index, std::size_t target, SaveState &state) {
+		std::size_t first = target;
+		while (!index[first].snapshot) {
+			--first;
+		}
+		JournalReader reader(file.data(), file.size());
+		SaveJournalRecord record;
+		for (std::size_t i = first; i <= target; ++i) {
+			reader.seek(index[i].offset);
+			reader.next(record);
+			apply_journal_record(state, record);
+		}
+	}
+
+	// Sends each recorded state through the publishers at its recorded time, scaled by the speed, and repeats the latest one at the publish interval in between, as the referee box itself would.
+	// Only the records of one session are replayed, so the hours or days between sessions are never waited out.
+	void replay(Logger &logger, const Configuration &configuration, const MappedFile &file, const std::vector<IndexEntry> &index, const Session &session, std::size_t start, double speed, const std::vector<Publisher *> &publishers, UDPTransmitter &transmitter) {
+		typedef std::chrono::steady_clock::duration Duration;
+		SaveState state;
+		seek(file, index, start, state);
+		logger.write(Glib::ustring::compose(u8"Replaying %1 of %2 records at %3× speed, from stage %4 and command counter %5.", session.end - start, session.end - session.begin, speed, SSL_Referee::Stage_Name(state.referee().stage()), state.referee().command_counter()));
+
+		// Everything is scheduled against absolute deadlines from one starting point, so the timing never drifts however long the recording.
+		const std::chrono::steady_clock::time_point real_start = std::chrono::steady_clock::now();
+		const uint64_t recorded_start = index[start].timestamp;
+		const std::chrono::microseconds publish_interval(configuration.publish_interval_milliseconds * 1000ULL);
+		auto real_time = [&](std::chrono::microseconds recorded) {
+			return real_start + std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::micro>(static_cast<double>(recorded.count()) / speed));
+		};
+		auto send = [&](std::chrono::microseconds recorded, unsigned int changes) {
+			state.mutable_referee()->set_packet_timestamp(recorded_start + static_cast<uint64_t>(recorded.count()));
+			for (Publisher *pub : publishers) {
+				pub->publish(state, changes);
+			}
+			transmitter.flush();
+		};
+
+		JournalReader reader(file.data(), file.size());
+		SaveJournalRecord record;
+		std::chrono::microseconds next_periodic(0), due(0);
+		for (std::size_t i = start; i < session.end; ++i) {
+			// Times within the recording count from the starting record; if the wall clock was set back during the session, later records follow at once rather than all at the start.
+			if (index[i].timestamp >= recorded_start) {
+				due = std::max(due, std::chrono::microseconds(index[i].timestamp - recorded_start));
+			}
+			if (i != start) {
+				while (next_periodic < due) {
+					std::this_thread::sleep_until(real_time(next_periodic));
+					send(next_periodic, 0);
+					next_periodic += publish_interval;
+				}
+				std::this_thread::sleep_until(real_time(due));
+				SSL_Referee::Stage old_stage = state.referee().stage();
+				uint32_t old_counter = state.referee().command_counter();
+				reader.seek(index[i].offset);
+				reader.next(record);
+				apply_journal_record(state, record);
+				if (state.referee().stage() != old_stage) {
+					logger.write(Glib::ustring::compose(u8"Replaying stage %1.", SSL_Referee::Stage_Name(state.referee().stage())));
+				}
+				if (state.referee().command_counter() != old_counter) {
+					logger.write(Glib::ustring::compose(u8"Replaying command %1 (counter %2).", SSL_Referee::Command_Name(state.referee().command()), state.referee().command_counter()));
+				}
+			}
+			send(due, Publisher::CHANGE_ALL);
+			next_periodic = due + publish_interval;
+		}
+		logger.write(u8"Replay finished.");
+	}
+
+	int main_impl(int argc, char **argv) {
+		// Set the current locale.
+		std::locale::global(std::locale(""));
+
+		// Initialize Glib; nothing else is needed without a user interface or a main loop.
+		Glib::init();
+
+		// Parse the command-line arguments.
+		Glib::OptionContext option_context(u8"JOURNAL");
+		option_context.set_summary(u8"Replays a recorded game journal through the Referee Box publishers, sending the packets as they went out during the game.");
+		option_context.set_description(u8"The Referee Box is © RoboCup Federation, 2003–2013.");
+
+		Glib::OptionGroup option_group(u8"replay", u8"Replay Options", u8"Show Replay Options");
+
+		Glib::OptionEntry config_file_entry;
+		config_file_entry.set_long_name(u8"config");
+		config_file_entry.set_short_name('C');
+		config_file_entry.set_description(u8"Sets the name of the configuration file whose addresses, ports, and publish interval are used (defaults to referee.conf).");
+		config_file_entry.set_arg_description(u8"CONFIGFILE");
+		std::string config_filename("referee.conf");
+		option_group.add_entry_filename(config_file_entry, config_filename);
+
+		Glib::OptionEntry speed_entry;
+		speed_entry.set_long_name(u8"speed");
+		speed_entry.set_short_name('s');
+		speed_entry.set_description(u8"Sets how many times faster than real time to replay (defaults to 1).");
+		speed_entry.set_arg_description(u8"FACTOR");
+		double speed = 1.0;
+		option_group.add_entry(speed_entry, speed);
+
+		Glib::OptionEntry session_entry;
+		session_entry.set_long_name(u8"session");
+		session_entry.set_description(u8"Replays the given session of a journal that a game was resumed into, counting from 1 (defaults to the last).");
+		session_entry.set_arg_description(u8"NUMBER");
+		int session_number = 0;
+		option_group.add_entry(session_entry, session_number);
+
+		Glib::OptionEntry stage_entry;
+		stage_entry.set_long_name(u8"stage");
+		stage_entry.set_description(u8"Starts the replay where the game enters a stage, such as NORMAL_SECOND_HALF.");
+		stage_entry.set_arg_description(u8"STAGE");
+		Glib::ustring stage_name;
+		option_group.add_entry(stage_entry, stage_name);
+
+		Glib::OptionEntry counter_entry;
+		counter_entry.set_long_name(u8"command-counter");
+		counter_entry.set_description(u8"Starts the replay where the command counter reaches a value.");
+		counter_entry.set_arg_description(u8"COUNTER");
+		int command_counter = -1;
+		option_group.add_entry(counter_entry, command_counter);
+
+		option_context.set_main_group(option_group);
+		option_context.parse(argc, argv);
+		if (argc != 2) {
+			std::cerr << option_context.get_help();
+			return 1;
+		}
+		if (!(speed > 0.0)) {
+			throw std::runtime_error("The speed must be positive.");
+		}
+
+		Configuration configuration(config_filename);
+		Logger logger("");
+
+		// Map the journal and index it, then build the same publishers the referee box uses.
+		MappedFile file(argv[1]);
+		if (!JournalReader::is_journal(file.data(), file.size())) {
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"File \"%1\" is not a game journal.", Glib::filename_to_utf8(argv[1]))));
+		}
+		std::vector<Session> sessions;
+		const std::vector<IndexEntry> &index = build_index(file, sessions);
+		if (index.empty()) {
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Game journal \"%1\" holds no game state.", Glib::filename_to_utf8(argv[1]))));
+		}
+		if (session_number < 0 || static_cast<std::size_t>(session_number) > sessions.size()) {
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Game journal \"%1\" holds only %2 sessions.", Glib::filename_to_utf8(argv[1]), sessions.size())));
+		}
+		const Session &session = sessions[session_number ? static_cast<std::size_t>(session_number) - 1 : sessions.size() - 1];
+		if (sessions.size() > 1) {
+			logger.write(Glib::ustring::compose(u8"Game journal holds %1 sessions; replaying session %2.", sessions.size(), session_number ? static_cast<std::size_t>(session_number) : sessions.size()));
+		}
+		std::size_t start = find_start(index, session, stage_name, command_counter);
+
+		UDPTransmitter transmitter(logger, configuration.interface);
+		std::unique_ptr<ProtobufPublisher> protobuf_publisher(configuration.protobuf_port.empty() ? nullptr : new ProtobufPublisher(configuration, transmitter));
+		std::unique_ptr<LegacyPublisher> legacy_publisher(configuration.legacy_port.empty() ? nullptr : new LegacyPublisher(configuration, transmitter));
+		std::vector<Publisher *> publishers;
+		if (protobuf_publisher) {
+			publishers.push_back(protobuf_publisher.get());
+		}
+		if (legacy_publisher) {
+			publishers.push_back(legacy_publisher.get());
+		}
+
+		replay(logger, configuration, file, index, session, start, speed, publishers, transmitter);
+
+		// Shut down protobuf.
+		google::protobuf::ShutdownProtobufLibrary();
+
+		return 0;
+	}
+
+	void print_exception(const Glib::Exception &exp) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+	}
+
+	void print_exception(const std::exception &exp, bool first = true) {
+		if (first) {
+			std::cerr << "\nUnhandled exception:\n";
+		} else {
+			std::cerr << "Caused by:\n";
+		}
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+		try {
+			std::rethrow_if_nested(exp);
+		} catch (const std::exception &exp) {
+			print_exception(exp, false);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	try {
+		return main_impl(argc, argv);
+	} catch (const Glib::Exception &exp) {
+		print_exception(exp);
+	} catch (const std::exception &exp) {
+		print_exception(exp);
+	} catch (...) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   Unknown\n";
+		std::cerr << "Detail: Unknown\n";
+	}
+	return 1;
+}
@@ -0,0 +1,58 @@
+#include "ringbuffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+	std::size_t round_up_power_of_two(std::size_t value) {
+		std::size_t result = 1;
+		while (result < value) {
+			result <<= 1;
+		}
+		return result;
+	}
+}
+
+RingBuffer::RingBuffer(std::size_t capacity) :
+		data(round_up_power_of_two(capacity)),
+		mask(data.size() - 1),
+		head(0),
+		tail(0) {
+}
+
+std::size_t RingBuffer::write_length() const {
+	return std::min(space(), data.size() - (tail & mask));
+}
+
+void RingBuffer::commit(std::size_t length) {
+	assert(length <= write_length());
+	tail += length;
+}
+
+void RingBuffer::peek(std::size_t offset, void *dest, std::size_t length) const {
+	assert(offset + length <= size());
+	std::size_t start = (head + offset) & mask;
+	std::size_t first = std::min(length, data.size() - start);
+	unsigned char *dest_ch = static_cast<unsigned char *>(dest);
+	std::memcpy(dest_ch, &data[start], first);
+	std::memcpy(dest_ch + first, &data[0], length - first);
+}
+
+const unsigned char *RingBuffer::contiguous(std::size_t offset, std::size_t length, std::vector<unsigned char> &scratch) const {
+	std::size_t start = (head + offset) & mask;
+	if (start + length <= data.size()) {
+		return &data[start];
+	}
+	scratch.resize(length);
+	peek(offset, &scratch[0], length);
+	return &scratch[0];
+}
+
+void RingBuffer::consume(std::size_t length) {
+	assert(length <= size());
+	head += length;
+	if (head == tail) {
+		// Start over at the beginning when empty, so the next read gets the whole ring as one contiguous region.
+		head = tail = 0;
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include "noncopyable.h"
+#include <cstddef>
+#include <vector>
+
+// A fixed-capacity byte ring for streamed input, filled directly by reads and drained from the front as complete records are decoded.
+class RingBuffer : public NonCopyable {
+	public:
+		// Creates a ring holding at least capacity bytes; the capacity is rounded up to a power of two.
+		explicit RingBuffer(std::size_t capacity);
+
+		// Returns the number of bytes held.
+		std::size_t size() const;
+
+		// Returns the number of bytes that can still be added.
+		std::size_t space() const;
+
+		// Returns the start of the largest contiguous free region, whose length is given by write_length, for a read to fill directly.
+		unsigned char *write_pointer();
+		std::size_t write_length() const;
+
+		// Marks length bytes written at write_pointer as held.
+		void commit(std::size_t length);
+
+		// Copies length bytes starting offset bytes from the front into dest, following the wrap if needed.
+		void peek(std::size_t offset, void *dest, std::size_t length) const;
+
+		// Returns a pointer to length bytes starting offset bytes from the front.
+		// The bytes are used in place unless they wrap around the end of the ring, in which case they are copied into scratch.
+		const unsigned char *contiguous(std::size_t offset, std::size_t length, std::vector<unsigned char> &scratch) const;
+
+		// Drops length bytes from the front.
+		void consume(std::size_t length);
+
+	private:
+		std::vector<unsigned char> data;
+		std::size_t mask;
+		std::size_t head, tail;
+};
+
+
+
+inline std::size_t RingBuffer::size() const {
+	return tail - head;
+}
+
+inline std::size_t RingBuffer::space() const {
+	return data.size() - size();
+}
+
+inline unsigned char *RingBuffer::write_pointer() {
+	return &data[tail & mask];
+}
+
+#endif
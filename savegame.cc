@@ -1,11 +1,20 @@
 #include "savegame.h"
+#include "mappedfile.h"
 #include "noncopyable.h"
 #include "referee.pb.h"
 #include "savestate.pb.h"
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 #include <glibmm/convert.h>
 #include <glibmm/ustring.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/repeated_field.h>
 
 #ifdef __linux__
 #include "exception.h"
@@ -20,9 +29,10 @@ namespace {
 		public:
 			FD(const std::string &filename, int options, int mode);
 			~FD();
+			off_t size();
 			void write(const void *data, std::size_t length);
+			void truncate(off_t length);
 			void fsync();
-			void close();
 
 		private:
 			int fd;
@@ -38,10 +48,19 @@ FD::FD(const std::string &filename, int options, int mode) : fd(::open(filename.
 
 FD::~FD() {
 	if (fd >= 0) {
-		close();
+		// Destructors must not throw, so ignore errors here.
+		::close(fd);
 	}
 }
 
+off_t FD::size() {
+	off_t off = ::lseek(fd, 0, SEEK_END);
+	if (off < 0) {
+		throw SystemError("Error seeking in saved state file");
+	}
+	return off;
+}
+
 void FD::write(const void *data, std::size_t length) {
 	ssize_t ssz = ::write(fd, data, length);
 	if (ssz != static_cast<ssize_t>(length)) {
@@ -49,57 +68,548 @@ void FD::write(const void *data, std::size_t length) {
 	}
 }
 
+void FD::truncate(off_t length) {
+	if (::ftruncate(fd, length) < 0) {
+		throw SystemError("Error truncating saved state file");
+	}
+}
+
 void FD::fsync() {
 	if (::fsync(fd) < 0) {
 		throw SystemError("Error flushing saved state file");
 	}
 }
 
-void FD::close() {
-	if (::close(fd) < 0) {
-		throw SystemError("Error closing saved state file");
+#endif
+
+namespace {
+	typedef google::protobuf::RepeatedField<google::protobuf::uint32> FieldNumbers;
+
+	const char JOURNAL_MAGIC[4] = {'S', 'S', 'L', 'J'};
+	const unsigned int SNAPSHOT_INTERVAL = 64;
+
+	// Returns whether a record of a kind may be replaced by a later state when the writer falls behind.
+	// Periodic clock checkpoints and minor edits lose nothing but their intermediate values that way.
+	bool is_coalescable(SaveJournalRecord::Kind kind) {
+		return kind == SaveJournalRecord::CLOCK || kind == SaveJournalRecord::OTHER;
+	}
+
+	bool field_values_equal(const google::protobuf::Message &a, const google::protobuf::Message &b, const google::protobuf::FieldDescriptor *field, int index) {
+		const google::protobuf::Reflection &ra = *a.GetReflection();
+		const google::protobuf::Reflection &rb = *b.GetReflection();
+		bool repeated = field->is_repeated();
+		switch (field->cpp_type()) {
+			case google::protobuf::FieldDescriptor::CPPTYPE_INT32: return repeated ? ra.GetRepeatedInt32(a, field, index) == rb.GetRepeatedInt32(b, field, index) : ra.GetInt32(a, field) == rb.GetInt32(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_INT64: return repeated ? ra.GetRepeatedInt64(a, field, index) == rb.GetRepeatedInt64(b, field, index) : ra.GetInt64(a, field) == rb.GetInt64(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_UINT32: return repeated ? ra.GetRepeatedUInt32(a, field, index) == rb.GetRepeatedUInt32(b, field, index) : ra.GetUInt32(a, field) == rb.GetUInt32(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_UINT64: return repeated ? ra.GetRepeatedUInt64(a, field, index) == rb.GetRepeatedUInt64(b, field, index) : ra.GetUInt64(a, field) == rb.GetUInt64(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE: return repeated ? ra.GetRepeatedDouble(a, field, index) == rb.GetRepeatedDouble(b, field, index) : ra.GetDouble(a, field) == rb.GetDouble(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT: return repeated ? ra.GetRepeatedFloat(a, field, index) == rb.GetRepeatedFloat(b, field, index) : ra.GetFloat(a, field) == rb.GetFloat(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_BOOL: return repeated ? ra.GetRepeatedBool(a, field, index) == rb.GetRepeatedBool(b, field, index) : ra.GetBool(a, field) == rb.GetBool(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_ENUM: return repeated ? ra.GetRepeatedEnum(a, field, index) == rb.GetRepeatedEnum(b, field, index) : ra.GetEnum(a, field) == rb.GetEnum(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_STRING: return repeated ? ra.GetRepeatedString(a, field, index) == rb.GetRepeatedString(b, field, index) : ra.GetString(a, field) == rb.GetString(b, field);
+			case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE: return repeated ? ra.GetRepeatedMessage(a, field, index).SerializePartialAsString() == rb.GetRepeatedMessage(b, field, index).SerializePartialAsString() : ra.GetMessage(a, field).SerializePartialAsString() == rb.GetMessage(b, field).SerializePartialAsString();
+		}
+		return false;
+	}
+
+	// Given changed initially holding a copy of the new value of a message, removes every field whose value is the same in from.
+	// Fields present in from but absent from the new value are recorded in cleared.
+	// The skip field, if any, is left alone.
+	void strip_unchanged(const google::protobuf::Message &from, google::protobuf::Message &changed, FieldNumbers &cleared, const google::protobuf::FieldDescriptor *skip) {
+		const google::protobuf::Descriptor &desc = *changed.GetDescriptor();
+		const google::protobuf::Reflection &rf = *from.GetReflection();
+		const google::protobuf::Reflection &rc = *changed.GetReflection();
+		for (int i = 0; i < desc.field_count(); ++i) {
+			const google::protobuf::FieldDescriptor *field = desc.field(i);
+			if (field == skip) {
+				continue;
+			}
+			if (field->is_repeated()) {
+				int size = rc.FieldSize(changed, field);
+				if (size == rf.FieldSize(from, field)) {
+					bool equal = true;
+					for (int j = 0; equal && j < size; ++j) {
+						equal = field_values_equal(from, changed, field, j);
+					}
+					if (equal) {
+						rc.ClearField(&changed, field);
+					}
+				} else if (!size) {
+					cleared.Add(static_cast<google::protobuf::uint32>(field->number()));
+				}
+			} else if (!rc.HasField(changed, field)) {
+				if (rf.HasField(from, field)) {
+					cleared.Add(static_cast<google::protobuf::uint32>(field->number()));
+				}
+			} else if (rf.HasField(from, field) && field_values_equal(from, changed, field, -1)) {
+				rc.ClearField(&changed, field);
+			}
+		}
+	}
+
+	// Clears, in target, every field that is present in source, except for the skip field.
+	void clear_present_fields(google::protobuf::Message &target, const google::protobuf::Message &source, const google::protobuf::FieldDescriptor *skip) {
+		std::vector<const google::protobuf::FieldDescriptor *> fields;
+		source.GetReflection()->ListFields(source, &fields);
+		for (const google::protobuf::FieldDescriptor *field : fields) {
+			if (field != skip) {
+				target.GetReflection()->ClearField(&target, field);
+			}
+		}
 	}
-	fd = -1;
+
+	// Clears, in target, every field whose number appears in numbers.
+	void clear_numbered_fields(google::protobuf::Message &target, const FieldNumbers &numbers) {
+		for (google::protobuf::uint32 number : numbers) {
+			const google::protobuf::FieldDescriptor *field = target.GetDescriptor()->FindFieldByNumber(static_cast<int>(number));
+			if (field) {
+				target.GetReflection()->ClearField(&target, field);
+			}
+		}
+	}
+
+	bool has_any_field(const google::protobuf::Message &message) {
+		std::vector<const google::protobuf::FieldDescriptor *> fields;
+		message.GetReflection()->ListFields(message, &fields);
+		return !fields.empty();
+	}
+
+	const google::protobuf::FieldDescriptor *referee_field() {
+		return SaveState::descriptor()->FindFieldByNumber(SaveState::kRefereeFieldNumber);
+	}
+
+	// Fills in the changed and cleared fields of a delta record that turns from into to.
+	void make_delta(const SaveState &from, const SaveState &to, SaveJournalRecord &record) {
+		SaveState &changed = *record.mutable_changed();
+		changed = to;
+		strip_unchanged(from, changed, *record.mutable_cleared_fields(), referee_field());
+		strip_unchanged(from.referee(), *changed.mutable_referee(), *record.mutable_cleared_referee_fields(), nullptr);
+		if (!has_any_field(changed.referee())) {
+			changed.clear_referee();
+		}
+		if (!has_any_field(changed)) {
+			record.clear_changed();
+		}
+	}
+
+	void append_uint32_be(std::string &buffer, uint32_t value) {
+		buffer.push_back(static_cast<char>(value >> 24));
+		buffer.push_back(static_cast<char>(value >> 16));
+		buffer.push_back(static_cast<char>(value >> 8));
+		buffer.push_back(static_cast<char>(value));
+	}
+
+	uint32_t read_uint32_be(const char *data) {
+		const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+		return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+	}
+
+	// Returns how many bytes at the start of a file hold the journal magic and complete records, or zero if it is not a game journal at all.
+	// Anything after that was cut off by a crash and would hide every record appended behind it.
+	std::size_t complete_journal_length(const char *data, std::size_t size) {
+		if (!JournalReader::is_journal(data, size)) {
+			return 0;
+		}
+		JournalReader reader(data, size);
+		SaveJournalRecord record;
+		while (reader.next(record)) {
+		}
+		return reader.tell();
+	}
+
+	// Appends records to a game journal file.
+	// Records accumulate in memory until commit() writes and flushes them all at once.
+	class JournalFile : public NonCopyable {
+		public:
+			JournalFile(const std::string &filename, bool append);
+			void append(const SaveState &ss, SaveJournalRecord::Kind kind, uint64_t timestamp);
+			void commit();
+
+		private:
+			const std::string filename;
+			const bool append_to_existing;
+#ifdef __linux__
+			std::unique_ptr<FD> fd;
+			off_t committed_size;
+#else
+			std::ofstream ofs;
+			bool empty;
+#endif
+			std::string pending;
+			SaveState last;
+			bool have_last;
+			// Whether the snapshot marking the start of this session is on disk, or waiting in pending.
+			bool session_committed, session_pending;
+			unsigned int records_since_snapshot;
+
+			void open();
+	};
 }
+
+JournalFile::JournalFile(const std::string &filename, bool append) :
+		filename(filename),
+		append_to_existing(append),
+#ifdef __linux__
+		committed_size(0),
+#else
+		empty(true),
 #endif
+		have_last(false),
+		session_committed(false),
+		session_pending(false),
+		records_since_snapshot(0) {
+}
 
-void save_game(const SaveState &ss, const std::string &save_filename) {
-	// We never save the current game state if we are in post-game.
-	// It is better to leave the save file holding the last state just before we ended the game.
-	// Thus, if the transition to post-game was accidental, the operator can recover.
-	if (ss.referee().stage() == SSL_Referee::POST_GAME) {
-		return;
+void JournalFile::append(const SaveState &ss, SaveJournalRecord::Kind kind, uint64_t timestamp) {
+	SaveJournalRecord record;
+	record.set_timestamp(timestamp);
+	if (!have_last || records_since_snapshot >= SNAPSHOT_INTERVAL) {
+		// Write a full snapshot at the start of each session and periodically thereafter, so a resume only needs to replay a short tail.
+		record.set_kind(SaveJournalRecord::SNAPSHOT);
+		*record.mutable_snapshot() = ss;
+		records_since_snapshot = 0;
+		if (!session_committed && !session_pending) {
+			record.set_session_start(true);
+			session_pending = true;
+		}
+	} else {
+		make_delta(last, ss, record);
+		if (!record.has_changed() && !record.cleared_fields_size() && !record.cleared_referee_fields_size()) {
+			// Nothing changed, so there is nothing worth recording.
+			return;
+		}
+		record.set_kind(ss.referee().stage() != last.referee().stage() ? SaveJournalRecord::STAGE : kind);
+		++records_since_snapshot;
 	}
+	last = ss;
+	have_last = true;
 
-	// If there’s no filename provided, don’t try to save.
-	if (save_filename.empty()) {
+	// Frame the record with its length.
+	std::string data;
+	if (!record.SerializePartialToString(&data)) {
+		throw std::runtime_error("Protobuf error serializing game journal record!");
+	}
+	append_uint32_be(pending, static_cast<uint32_t>(data.size()));
+	pending += data;
+}
+
+void JournalFile::commit() {
+	if (pending.empty()) {
 		return;
 	}
 
 #ifdef __linux__
-	// On Linux, we can do the 100%-safe create-new-file, write-to-new-file, fsync-new-file, close-new-file, rename-over-old-file method.
-	std::string data;
-	if (!ss.SerializeToString(&data)) {
-		throw std::runtime_error("Protobuf error serializing game state!");
-	}
-	std::string temp_filename = save_filename + ".new";
-	FD fd(temp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-	fd.write(data.data(), data.size());
-	fd.fsync();
-	fd.close();
-	if (::rename(temp_filename.c_str(), save_filename.c_str()) < 0) {
-		int rc = errno;
-		throw SystemError(Glib::locale_from_utf8(Glib::ustring::compose(u8"I/O error renaming \"%1\" to \"%2\"!", Glib::filename_to_utf8(temp_filename), Glib::filename_to_utf8(save_filename))), rc);
+	// On Linux, append the whole batch with a single write and then fsync, so a burst of records costs only one flush.
+	try {
+		open();
+		if (!committed_size) {
+			pending.insert(0, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+		}
+		fd->write(pending.data(), pending.size());
+		fd->fsync();
+		committed_size += static_cast<off_t>(pending.size());
+		session_committed = session_committed || session_pending;
+	} catch (...) {
+		// Cut any partly written record off the end of the file so that later records remain readable, drop the failed batch, and start over with a snapshot.
+		if (fd) {
+			try {
+				fd->truncate(committed_size);
+			} catch (...) {
+				// Swallow exceptions; the original error is more useful.
+			}
+		}
+		pending.clear();
+		have_last = false;
+		session_pending = false;
+		throw;
 	}
 #else
 	// On other platforms, just do an ordinary C++ file write and hope we don’t get a whole system crash or power loss that destroys the file.
-	std::ofstream ofs;
-	ofs.exceptions(std::ios_base::badbit | std::ios_base::failbit);
-	ofs.open(save_filename, std::ios_base::out | std::ios_base::binary);
-	if (!ss.SerializeToOstream(&ofs)) {
-		throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Protobuf error saving game state to file \"%1\"!", Glib::filename_to_utf8(save_filename))));
+	try {
+		open();
+		if (empty) {
+			pending.insert(0, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+		}
+		ofs.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+		ofs.flush();
+		empty = false;
+		session_committed = session_committed || session_pending;
+	} catch (...) {
+		pending.clear();
+		have_last = false;
+		session_pending = false;
+		throw;
+	}
+#endif
+	pending.clear();
+}
+
+void JournalFile::open() {
+#ifdef __linux__
+	if (fd) {
+		return;
 	}
-	ofs.close();
+	fd.reset(new FD(filename, O_RDWR | O_CREAT | O_APPEND, 0666));
+	off_t size = fd->size();
+	committed_size = 0;
+	if (append_to_existing && size) {
+		// Keep only the complete records; an existing file that is not a journal (e.g. a saved state file from an older version that was resumed from) is replaced.
+		MappedFile file(filename);
+		committed_size = static_cast<off_t>(complete_journal_length(file.data(), file.size()));
+	}
+	if (committed_size != size) {
+		fd->truncate(committed_size);
+	}
+#else
+	if (ofs.is_open()) {
+		return;
+	}
+	std::string kept;
+	if (append_to_existing) {
+		std::ifstream ifs(filename, std::ios_base::in | std::ios_base::binary);
+		kept.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		kept.resize(complete_journal_length(kept.data(), kept.size()));
+	}
+	// An ofstream cannot shorten a file, so rewrite the complete records and append after them.
+	ofs.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+	ofs.open(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	ofs.write(kept.data(), static_cast<std::streamsize>(kept.size()));
+	ofs.flush();
+	empty = kept.empty();
 #endif
 }
 
+
+
+void load_game(SaveState &ss, const std::string &filename) {
+	MappedFile file(filename);
+
+	if (!JournalReader::is_journal(file.data(), file.size())) {
+		// This is a plain saved state file.
+		if (file.size() > static_cast<std::size_t>(std::numeric_limits<int>::max()) || !ss.ParseFromArray(file.data(), static_cast<int>(file.size()))) {
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Protobuf error loading saved game state from file \"%1\"!", Glib::filename_to_utf8(filename))));
+		}
+		return;
+	}
+
+	// This is a game journal; only the last snapshot and the deltas after it matter.
+	// Find where every record starts by following the length prefixes alone, which is cheap even for a journal of many sessions.
+	JournalReader reader(file.data(), file.size());
+	std::vector<std::size_t> offsets;
+	for (std::size_t offset = reader.tell(); reader.skip(); offset = reader.tell()) {
+		offsets.push_back(offset);
+	}
+
+	// Parse backwards from the end to find the last snapshot.
+	// A record that does not parse was cut off by a crash, so it and everything after it are ignored.
+	std::size_t end = offsets.size();
+	const std::size_t none = offsets.size();
+	SaveJournalRecord record;
+	auto previous_snapshot = [&](std::size_t before) -> std::size_t {
+		for (std::size_t i = before; i-- > 0;) {
+			reader.seek(offsets[i]);
+			if (!reader.next(record)) {
+				end = i;
+			} else if (record.has_snapshot()) {
+				return i;
+			}
+		}
+		return none;
+	};
+	std::size_t first = previous_snapshot(end);
+	if (first == none) {
+		throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Protobuf error loading game journal from file \"%1\"!", Glib::filename_to_utf8(filename))));
+	}
+
+	// We never resume into post-game if we can help it; if the transition to post-game was accidental, the operator can recover.
+	// So remember the state just before the game ended, reaching back to earlier snapshots in the rare case that the game ended before the last one.
+	SaveState before_post_game;
+	bool have_before_post_game = false;
+	for (;;) {
+		ss.Clear();
+		for (std::size_t i = first; i < end; ++i) {
+			reader.seek(offsets[i]);
+			reader.next(record);
+			const SSL_Referee *new_referee = record.has_snapshot() ? &record.snapshot().referee() : record.changed().has_referee() ? &record.changed().referee() : nullptr;
+			if (i != first && ss.referee().stage() != SSL_Referee::POST_GAME && new_referee && new_referee->has_stage() && new_referee->stage() == SSL_Referee::POST_GAME) {
+				before_post_game = ss;
+				have_before_post_game = true;
+			}
+			apply_journal_record(ss, record);
+		}
+		if (ss.referee().stage() != SSL_Referee::POST_GAME || have_before_post_game || !first) {
+			break;
+		}
+		std::size_t earlier = previous_snapshot(first);
+		if (earlier == none) {
+			break;
+		}
+		first = earlier;
+	}
+
+	if (!ss.IsInitialized()) {
+		throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Protobuf error loading game journal from file \"%1\"!", Glib::filename_to_utf8(filename))));
+	}
+	if (ss.referee().stage() == SSL_Referee::POST_GAME && have_before_post_game) {
+		ss = before_post_game;
+	}
+}
+
+void apply_journal_record(SaveState &ss, const SaveJournalRecord &record) {
+	if (record.has_snapshot()) {
+		ss = record.snapshot();
+		return;
+	}
+
+	clear_numbered_fields(ss, record.cleared_fields());
+	clear_numbered_fields(*ss.mutable_referee(), record.cleared_referee_fields());
+	if (record.has_changed()) {
+		// Clear every field that changed, then merge in the new values; this gives replace semantics even for repeated and message fields.
+		const SaveState &changed = record.changed();
+		clear_present_fields(ss, changed, referee_field());
+		if (changed.has_referee()) {
+			clear_present_fields(*ss.mutable_referee(), changed.referee(), nullptr);
+		}
+		ss.MergeFrom(changed);
+	}
+}
+
+
+
+bool JournalReader::is_journal(const char *data, std::size_t size) {
+	return size >= sizeof(JOURNAL_MAGIC) && std::equal(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC), data);
+}
+
+JournalReader::JournalReader(const char *data, std::size_t size) : data(data), size(size), pos(sizeof(JOURNAL_MAGIC)) {
+}
+
+bool JournalReader::next(SaveJournalRecord &record) {
+	uint32_t length;
+	if (!complete_frame(length)) {
+		return false;
+	}
+	if (!record.ParsePartialFromArray(data + pos + 4, static_cast<int>(length)) || !record.has_kind() || !record.has_timestamp()) {
+		return false;
+	}
+	pos += 4 + length;
+	return true;
+}
+
+bool JournalReader::skip() {
+	uint32_t length;
+	if (!complete_frame(length)) {
+		return false;
+	}
+	pos += 4 + length;
+	return true;
+}
+
+bool JournalReader::complete_frame(uint32_t &length) const {
+	if (size - pos < 4) {
+		return false;
+	}
+	length = read_uint32_be(data + pos);
+	// If the record runs past the end, it was cut off by a crash.
+	return length <= size - pos - 4;
+}
+
+std::size_t JournalReader::tell() const {
+	return pos;
+}
+
+void JournalReader::seek(std::size_t offset) {
+	pos = offset;
+}
+
+
+
+SaveWriter::SaveWriter(const std::string &save_filename, const Clock &clock, bool append) : save_filename(save_filename), clock(clock), append(append), busy(false), stopping(false), thread(&SaveWriter::run, this) {
+}
+
+SaveWriter::~SaveWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	cond.notify_all();
+	// The writer thread drains the queue before exiting, so nothing submitted is lost.
+	thread.join();
+}
+
+void SaveWriter::submit(const SaveState &ss, SaveJournalRecord::Kind kind) {
+	// If there’s no filename provided, don’t bother copying the state.
+	if (save_filename.empty()) {
+		return;
+	}
+
+	// Take the snapshot before acquiring the lock, so the writer thread is never held up by the copy.
+	Entry entry;
+	entry.state.reset(new SaveState(ss));
+	entry.kind = kind;
+	entry.timestamp = static_cast<uint64_t>(clock.wall().count());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		rethrow_error();
+		// If the writer has fallen far behind, fold a minor change into the newest queued entry rather than blocking the caller, as long as that entry is minor too.
+		// Commands, cards, and the like are always queued, so the journal never loses one; the queue only grows past its capacity while storage stalls and such records keep arriving.
+		if (queue.size() >= QUEUE_CAPACITY && is_coalescable(kind) && is_coalescable(queue.back().kind)) {
+			queue.back() = std::move(entry);
+		} else {
+			queue.push_back(std::move(entry));
+		}
+	}
+	cond.notify_all();
+}
+
+void SaveWriter::flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	cond.wait(lock, [this]() { return queue.empty() && !busy; });
+	rethrow_error();
+}
+
+void SaveWriter::rethrow_error() {
+	// Must be called with the mutex held.
+	if (error) {
+		std::exception_ptr exp = error;
+		error = nullptr;
+		std::rethrow_exception(exp);
+	}
+}
+
+void SaveWriter::run() {
+	JournalFile journal(save_filename, append);
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		cond.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if (queue.empty()) {
+			return;
+		}
+
+		// Take everything queued so far as one batch.
+		std::deque<Entry> batch;
+		batch.swap(queue);
+		busy = true;
+
+		// Do the actual I/O without holding the lock.
+		// The whole batch is group-committed with a single fsync.
+		lock.unlock();
+		std::exception_ptr exp;
+		try {
+			for (const Entry &entry : batch) {
+				journal.append(*entry.state, entry.kind, entry.timestamp);
+			}
+			journal.commit();
+		} catch (...) {
+			exp = std::current_exception();
+		}
+		lock.lock();
+
+		// Hand any error back to the submitting thread.
+		if (exp) {
+			error = exp;
+		}
+		busy = false;
+		cond.notify_all();
+	}
+}
@@ -1,11 +1,91 @@
 #ifndef SAVEGAME_H
 #define SAVEGAME_H
 
+#include "noncopyable.h"
+#include "savestate.pb.h"
+#include "timing.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
-class SaveState;
+// Loads a saved game, either by replaying a game journal or from a plain saved state file written by older versions.
+void load_game(SaveState &ss, const std::string &filename);
 
-void save_game(const SaveState &ss, const std::string &save_filename);
+// Applies one game journal record on top of a state.
+void apply_journal_record(SaveState &ss, const SaveJournalRecord &record);
 
-#endif
+// Walks the records of a game journal held in memory, such as a mapped file.
+class JournalReader {
+	public:
+		// Returns whether data starts like a game journal rather than a plain saved state.
+		static bool is_journal(const char *data, std::size_t size);
+
+		// The data must be a game journal, and must outlive the reader.
+		JournalReader(const char *data, std::size_t size);
+
+		// Reads the next record, returning false at the end of the journal or at a record cut off by a crash.
+		bool next(SaveJournalRecord &record);
+
+		// Moves past the next record without parsing it, returning false at the end of the journal or at a record cut off by a crash.
+		bool skip();
+
+		// Returns the offset of the next record, for coming back to it with seek.
+		std::size_t tell() const;
+		void seek(std::size_t offset);
+
+	private:
+		const char *data;
+		std::size_t size;
+		std::size_t pos;
+
+		bool complete_frame(uint32_t &length) const;
+};
+
+// Appends game state changes to a journal on a dedicated thread so that slow storage never stalls the caller.
+class SaveWriter : public NonCopyable {
+	public:
+		// Records are timestamped with the wall time of the given clock.
+		// If append is set, as when resuming, records follow the complete ones already in the file; otherwise any existing file is replaced by a fresh journal.
+		SaveWriter(const std::string &save_filename, const Clock &clock, bool append);
+		~SaveWriter();
 
+		// Queues a copy of the state to be journalled; never blocks on I/O.
+		// Once QUEUE_CAPACITY entries are waiting, a clock checkpoint or other minor change replaces the newest queued entry if that is also minor.
+		// Commands and cards are never replaced, so the queue may grow past its capacity while storage is stalled.
+		// Rethrows any error raised by an earlier background write.
+		void submit(const SaveState &ss, SaveJournalRecord::Kind kind);
+
+		// Waits until every queued state has been written and flushed to disk.
+		// Rethrows any error raised by an earlier background write.
+		void flush();
+
+	private:
+		struct Entry {
+			std::shared_ptr<const SaveState> state;
+			SaveJournalRecord::Kind kind;
+			uint64_t timestamp;
+		};
+
+		static const std::size_t QUEUE_CAPACITY = 64;
+
+		const std::string save_filename;
+		const Clock &clock;
+		const bool append;
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::deque<Entry> queue;
+		bool busy, stopping;
+		std::exception_ptr error;
+		std::thread thread;
+
+		void rethrow_error();
+		void run();
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include "addrinfolist.h"
+#include "exception.h"
+#include "gamestate.h"
+#include "noncopyable.h"
+#include "receivethread.h"
+#include "referee.pb.h"
+#include "socket.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <locale>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glibmm/exception.h>
+#include <glibmm/init.h>
+#include <glibmm/main.h>
+#include <glibmm/optioncontext.h>
+#include <glibmm/optionentry.h>
+#include <glibmm/optiongroup.h>
+#include <glibmm/ustring.h>
+#include <google/protobuf/stubs/common.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
+
+namespace {
+	// A packet from the second half of a match, with cards and a game event, as a referee box would send it.
+	SSL_Referee make_fixture() {
+		SSL_Referee ref;
+		ref.set_packet_timestamp(1500000000000000ULL);
+		ref.set_stage(SSL_Referee::NORMAL_SECOND_HALF);
+		ref.set_stage_time_left(187000000);
+		ref.set_command(SSL_Referee::NORMAL_START);
+		ref.set_command_counter(0);
+		ref.set_command_timestamp(1499999995000000ULL);
+		ref.set_blueteamonpositivehalf(false);
+		SSL_Referee::TeamInfo &yellow = *ref.mutable_yellow();
+		yellow.set_name(u8"ER-Force");
+		yellow.set_score(3);
+		yellow.set_red_cards(0);
+		yellow.add_yellow_card_times(61000000);
+		yellow.add_yellow_card_times(104000000);
+		yellow.set_yellow_cards(3);
+		yellow.set_timeouts(3);
+		yellow.set_timeout_time(253000000);
+		yellow.set_goalie(1);
+		SSL_Referee::TeamInfo &blue = *ref.mutable_blue();
+		blue.set_name(u8"TIGERs Mannheim");
+		blue.set_score(2);
+		blue.set_red_cards(1);
+		blue.add_yellow_card_times(12000000);
+		blue.set_yellow_cards(2);
+		blue.set_timeouts(2);
+		blue.set_timeout_time(169000000);
+		blue.set_goalie(0);
+		ref.mutable_gameevent()->set_gameeventtype(SSL_Referee_Game_Event::ATTACKER_IN_DEFENSE_AREA);
+		ref.mutable_gameevent()->mutable_originator()->set_team(SSL_Referee_Game_Event::TEAM_BLUE);
+		ref.mutable_gameevent()->mutable_originator()->set_botid(4);
+		ref.mutable_gameevent()->set_message(u8"Attacker touched the ball in the defense area");
+		return ref;
+	}
+
+	double nanoseconds(std::chrono::steady_clock::duration d) {
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	}
+
+	// Writes a result as one line of JSON in the same form as refbox_bench, with times in nanoseconds per packet.
+	void report(std::ostream &out, const std::string &benchmark, std::vector<double> &samples, uint64_t operations, const std::vector<std::pair<std::string, double>> &figures) {
+		std::sort(samples.begin(), samples.end());
+		double total = 0.0;
+		for (double sample : samples) {
+			total += sample;
+		}
+		auto percentile = [&samples](double p) {
+			return samples.empty() ? 0.0 : samples[std::min(samples.size() - 1, static_cast<std::size_t>(p * static_cast<double>(samples.size())))];
+		};
+		out << "{\"benchmark\":\"" << benchmark << '"';
+		out << ",\"operations\":" << operations;
+		out << ",\"mean_ns\":" << (samples.empty() ? 0.0 : total / static_cast<double>(samples.size()));
+		out << ",\"p50_ns\":" << percentile(0.5);
+		out << ",\"p99_ns\":" << percentile(0.99);
+		out << ",\"max_ns\":" << (samples.empty() ? 0.0 : samples.back());
+		for (const std::pair<std::string, double> &figure : figures) {
+			out << ",\"" << figure.first << "\":" << figure.second;
+		}
+		out << "}\n" << std::flush;
+	}
+
+	// A socket sending multicast packets on one interface, looped back to this host.
+	class Sender : public NonCopyable {
+		public:
+			Sender(const std::string &interface, const std::string &group, const std::string &port) : sock(AF_INET, SOCK_DGRAM, 0) {
+				addrinfo hints;
+				std::memset(&hints, 0, sizeof(hints));
+				hints.ai_family = AF_INET;
+				hints.ai_socktype = SOCK_DGRAM;
+				AddrInfoList ail(group.c_str(), port.c_str(), &hints);
+				std::memcpy(&dest, ail.get()->ai_addr, ail.get()->ai_addrlen);
+				dest_len = ail.get()->ai_addrlen;
+
+#ifndef WIN32
+				ip_mreqn req;
+				std::memset(&req, 0, sizeof(req));
+				req.imr_ifindex = static_cast<int>(if_nametoindex(interface.c_str()));
+				if (!req.imr_ifindex) {
+					throw SystemError(Glib::ustring::compose(u8"Cannot look up index of network interface %1", interface));
+				}
+				if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &req, sizeof(req)) < 0) {
+					throw SystemError("Cannot set multicast interface");
+				}
+#endif
+				static const int ONE = 1;
+				setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char *>(&ONE), sizeof(ONE));
+			}
+
+			void send(const std::string &packet) {
+				if (sendto(sock, packet.data(), packet.size(), 0, reinterpret_cast<const sockaddr *>(&dest), dest_len) < 0) {
+					throw SystemError("Cannot send packet");
+				}
+			}
+
+		private:
+			Socket sock;
+			sockaddr_storage dest;
+			socklen_t dest_len;
+	};
+
+	int main_impl(int argc, char **argv) {
+		// Set the current locale.
+		std::locale::global(std::locale(""));
+
+		// Initialize Glib; packets are handed over to a main loop, but no user interface is needed.
+		Glib::init();
+
+		// Parse the command-line arguments.
+		Glib::OptionContext option_context;
+		option_context.set_summary(u8"Measures how fast the Scoreboard receives and parses referee packets, sending them to itself over multicast loopback.");
+		option_context.set_description(u8"The Referee Box is © RoboCup Federation, 2013–2013.");
+
+		Glib::OptionGroup option_group(u8"bench", u8"Benchmark Options", u8"Show Benchmark Options");
+
+		Glib::OptionEntry mc_interface_entry;
+		mc_interface_entry.set_long_name(u8"interface");
+		mc_interface_entry.set_short_name('i');
+		mc_interface_entry.set_description(u8"Sets the network interface name on which packets will be looped back (defaults to lo).");
+		mc_interface_entry.set_arg_description(u8"INTERFACE");
+		Glib::ustring mc_interface(u8"lo");
+		option_group.add_entry(mc_interface_entry, mc_interface);
+
+		Glib::OptionEntry mc_group_entry;
+		mc_group_entry.set_long_name(u8"group");
+		mc_group_entry.set_short_name('g');
+		mc_group_entry.set_description(u8"Sets the multicast group to send to and join.");
+		mc_group_entry.set_arg_description(u8"ADDRESS");
+		Glib::ustring mc_group(u8"224.5.23.1");
+		option_group.add_entry(mc_group_entry, mc_group);
+
+		Glib::OptionEntry mc_port_entry;
+		mc_port_entry.set_long_name(u8"port");
+		mc_port_entry.set_short_name('p');
+		mc_port_entry.set_description(u8"Sets the UDP port to use, which should differ from any real referee box’s (defaults to 10013).");
+		mc_port_entry.set_arg_description(u8"PORT");
+		Glib::ustring mc_port(u8"10013");
+		option_group.add_entry(mc_port_entry, mc_port);
+
+		Glib::OptionEntry scale_entry;
+		scale_entry.set_long_name(u8"scale");
+		scale_entry.set_short_name('s');
+		scale_entry.set_description(u8"Multiplies the number of packets sent (defaults to 1).");
+		scale_entry.set_arg_description(u8"FACTOR");
+		double scale = 1.0;
+		option_group.add_entry(scale_entry, scale);
+
+		Glib::OptionEntry output_entry;
+		output_entry.set_long_name(u8"output");
+		output_entry.set_short_name('o');
+		output_entry.set_description(u8"Sets the name of the file to write results to, one JSON object per line (defaults to scoreboard_bench.jsonl).");
+		output_entry.set_arg_description(u8"FILE");
+		std::string output_filename("scoreboard_bench.jsonl");
+		option_group.add_entry_filename(output_entry, output_filename);
+
+		option_context.set_main_group(option_group);
+		option_context.parse(argc, argv);
+		if (!(scale > 0.0)) {
+			throw std::runtime_error("The scale must be positive.");
+		}
+
+		// Keep numbers in the results machine-readable whatever the locale.
+		std::ofstream results;
+		results.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+		results.open(output_filename, std::ios_base::out | std::ios_base::trunc);
+		results.imbue(std::locale::classic());
+
+		// Start receiving exactly as the scoreboard does, and note the command counter of each packet it takes in, or that packets stopped arriving.
+		Socket::init_system();
+		GameState state(mc_interface, mc_group, mc_port);
+		ReceiveThread receive_thread({&state});
+		Sender sender(mc_interface, mc_group, mc_port);
+		uint32_t last_counter = 0;
+		bool timed_out = false;
+		state.signal_updated.connect([&state, &last_counter, &timed_out]() {
+			if (state.ok) {
+				last_counter = state.referee.command_counter();
+			} else {
+				timed_out = true;
+			}
+		});
+		Glib::RefPtr<Glib::MainContext> context = Glib::MainContext::get_default();
+
+		// Send single packets, to time each from send to update, and then bursts, as when the referee box sends on several interfaces or the scoreboard falls behind.
+		struct Case {
+			const char *benchmark;
+			unsigned int burst;
+			unsigned int rounds;
+		};
+		static const Case CASES[] = {
+			{"scoreboard_receive", 1, 5000},
+			{"scoreboard_receive_burst", 32, 500},
+		};
+		SSL_Referee ref = make_fixture();
+		uint32_t counter = 0;
+		for (const Case &c : CASES) {
+			const unsigned int rounds = std::max(1U, static_cast<unsigned int>(c.rounds * scale + 0.5));
+
+			// Serialize every packet in advance, each with its own command counter, so that only receiving is timed.
+			const uint32_t first_counter = counter + 1;
+			std::vector<std::string> packets(static_cast<std::size_t>(rounds) * c.burst);
+			for (std::string &packet : packets) {
+				ref.set_command_counter(++counter);
+				ref.SerializeToString(&packet);
+			}
+
+			std::vector<double> samples;
+			unsigned int lost = 0;
+			std::chrono::steady_clock::time_point all_start = std::chrono::steady_clock::now();
+			for (unsigned int round = 0; round < rounds; ++round) {
+				const std::string *burst = &packets[static_cast<std::size_t>(round) * c.burst];
+				const uint32_t expected = first_counter + (round + 1) * c.burst - 1;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (unsigned int i = 0; i < c.burst; ++i) {
+					sender.send(burst[i]);
+				}
+
+				// Wait for the last packet of the burst; if it was dropped, the scoreboard’s own three-second timeout ends the wait.
+				timed_out = false;
+				while (last_counter != expected && !timed_out) {
+					context->iteration(true);
+				}
+				if (last_counter != expected) {
+					++lost;
+					continue;
+				}
+				samples.push_back(nanoseconds(std::chrono::steady_clock::now() - start) / c.burst);
+			}
+			double elapsed = nanoseconds(std::chrono::steady_clock::now() - all_start);
+
+			std::vector<std::pair<std::string, double>> figures;
+			figures.emplace_back("burst", c.burst);
+			figures.emplace_back("packet_bytes", static_cast<double>(packets.front().size()));
+			figures.emplace_back("packets_per_second", static_cast<double>(packets.size()) / (elapsed / 1.0e9));
+			figures.emplace_back("lost_bursts", lost);
+			report(results, c.benchmark, samples, packets.size(), figures);
+		}
+
+		// Shut down protobuf.
+		google::protobuf::ShutdownProtobufLibrary();
+
+		return 0;
+	}
+
+	void print_exception(const Glib::Exception &exp) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+	}
+
+	void print_exception(const std::exception &exp, bool first = true) {
+		if (first) {
+			std::cerr << "\nUnhandled exception:\n";
+		} else {
+			std::cerr << "Caused by:\n";
+		}
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+		try {
+			std::rethrow_if_nested(exp);
+		} catch (const std::exception &exp) {
+			print_exception(exp, false);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	try {
+		return main_impl(argc, argv);
+	} catch (const Glib::Exception &exp) {
+		print_exception(exp);
+	} catch (const std::exception &exp) {
+		print_exception(exp);
+	} catch (...) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   Unknown\n";
+		std::cerr << "Detail: Unknown\n";
+	}
+	return 1;
+}
@@ -0,0 +1,96 @@
+#include "framesink.h"
+#include "exception.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+FrameSink::~FrameSink() {
+}
+
+PipeFrameSink::PipeFrameSink(const std::string &filename, std::size_t frame_size) : frame_size(frame_size) {
+	if (filename == "-") {
+		fd = 1;
+		close_fd = false;
+	} else {
+		// Opening a FIFO waits until the encoder opens the other end.
+		fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0) {
+			throw SystemError("Cannot open frame output " + filename);
+		}
+		close_fd = true;
+	}
+}
+
+PipeFrameSink::~PipeFrameSink() {
+	if (close_fd) {
+		close(fd);
+	}
+}
+
+void PipeFrameSink::write(const uint8_t *frame) {
+	std::size_t written = 0;
+	while (written < frame_size) {
+		ssize_t rc = ::write(fd, frame + written, frame_size - written);
+		if (rc < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw SystemError("Cannot write frame");
+		}
+		written += static_cast<std::size_t>(rc);
+	}
+}
+
+#ifndef WIN32
+ShmFrameSink::ShmFrameSink(const std::string &name, uint32_t width, uint32_t height, uint32_t slots) : name(name) {
+	const std::size_t frame_size = static_cast<std::size_t>(width) * height * 4;
+	length = sizeof(Header) + frame_size * slots;
+
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		throw SystemError("Cannot create shared memory object " + name);
+	}
+	if (ftruncate(fd, static_cast<off_t>(length)) < 0) {
+		int err = errno;
+		close(fd);
+		shm_unlink(name.c_str());
+		throw SystemError("Cannot size shared memory object " + name, err);
+	}
+	base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int err = errno;
+	close(fd);
+	if (base == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		throw SystemError("Cannot map shared memory object " + name, err);
+	}
+
+	header = static_cast<Header *>(base);
+	data = static_cast<uint8_t *>(base) + sizeof(Header);
+	std::memcpy(header->magic, "SSLSBFR1", sizeof(header->magic));
+	header->width = width;
+	header->height = height;
+	header->slots = slots;
+	header->reserved = 0;
+	header->frame_size = frame_size;
+	__atomic_store_n(&header->sequence, 0, __ATOMIC_RELEASE);
+}
+
+ShmFrameSink::~ShmFrameSink() {
+	munmap(base, length);
+	shm_unlink(name.c_str());
+}
+
+void ShmFrameSink::write(const uint8_t *frame) {
+	// Fill the slot after the newest frame, then publish it; readers never see a frame before it is complete.
+	uint64_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_RELAXED) + 1;
+	std::memcpy(data + static_cast<std::size_t>((sequence - 1) % header->slots) * header->frame_size, frame, header->frame_size);
+	__atomic_store_n(&header->sequence, sequence, __ATOMIC_RELEASE);
+}
+#endif
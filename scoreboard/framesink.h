@@ -0,0 +1,59 @@
+#ifndef FRAMESINK_H
+#define FRAMESINK_H
+
+#include "noncopyable.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A destination for raw video frames of a fixed size.
+// Each frame is a sequence of rows, top to bottom, of four bytes per pixel in red, green, blue, alpha order, with no padding.
+class FrameSink : public NonCopyable {
+	public:
+		virtual ~FrameSink();
+		virtual void write(const uint8_t *frame) = 0;
+};
+
+// Writes frames one after another to a file, typically a pipe or FIFO feeding an encoder, or to standard output if the name is “-”.
+class PipeFrameSink : public FrameSink {
+	public:
+		PipeFrameSink(const std::string &filename, std::size_t frame_size);
+		~PipeFrameSink();
+		void write(const uint8_t *frame);
+
+	private:
+		int fd;
+		bool close_fd;
+		std::size_t frame_size;
+};
+
+#ifndef WIN32
+// Writes frames into a ring of slots in a POSIX shared memory object, for a reader that maps the object and takes the newest frame whenever it wants one.
+//
+// The object starts with a Header, after which come the slots, each frame_size bytes long.
+// Frame number N (counting from 1) is in slot (N − 1) modulo slots, and the header’s sequence field is the number of the newest complete frame, zero before the first.
+// A reader should load the sequence with acquire ordering, copy the frame, then check that the sequence has not advanced by slots − 1 or more meanwhile, in which case the copy may be torn.
+class ShmFrameSink : public FrameSink {
+	public:
+		struct Header {
+			// The characters “SSLSBFR1”.
+			char magic[8];
+			uint32_t width, height, slots, reserved;
+			uint64_t frame_size;
+			uint64_t sequence;
+		};
+
+		ShmFrameSink(const std::string &name, uint32_t width, uint32_t height, uint32_t slots);
+		~ShmFrameSink();
+		void write(const uint8_t *frame);
+
+	private:
+		std::string name;
+		std::size_t length;
+		void *base;
+		Header *header;
+		uint8_t *data;
+};
+#endif
+
+#endif
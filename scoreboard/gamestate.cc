@@ -4,9 +4,10 @@
 #include "addrinfolist.h"
 #include "exception.h"
 #include <cerrno>
+#include <cstring>
 #include <iostream>
-#include <stdexcept>
 #include <string>
+#include <utility>
 #include <glibmm/convert.h>
 #include <glibmm/main.h>
 #include <glibmm/ustring.h>
@@ -24,7 +25,24 @@
 #include <sys/types.h>
 #endif
 
-GameState::GameState(const std::string &interface, const std::string &group, const std::string &port) : ok(false) {
+GameState::Receiver::Receiver(Socket &&sock) : sock(std::move(sock)), kernel_drops(0) {
+}
+
+GameState::GameState(const std::string &interface, const std::string &group, const std::string &port) : ok(false), have_pending(false), published_stats(), stats(), reported_stats(), buffers(BATCH_SIZE * (MAX_PACKET_SIZE + 1)), lengths(BATCH_SIZE), truncated(BATCH_SIZE) {
+	// Point each message of a batch at its own buffer, with one byte to spare so that an oversized datagram shows up as one that filled the buffer.
+#ifdef __linux__
+	iovs.resize(BATCH_SIZE);
+	msgs.resize(BATCH_SIZE);
+	controls.resize(BATCH_SIZE * CMSG_SPACE(sizeof(uint32_t)));
+	for (std::size_t i = 0; i < BATCH_SIZE; ++i) {
+		iovs[i].iov_base = &buffers[i * (MAX_PACKET_SIZE + 1)];
+		iovs[i].iov_len = MAX_PACKET_SIZE + 1;
+		std::memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+#endif
+
 	// Get a list of addresses to bind to.
 	addrinfo hints;
 	hints.ai_flags = AI_PASSIVE;
@@ -106,41 +124,154 @@ GameState::GameState(const std::string &interface, const std::string &group, con
 						setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &ONE, sizeof(ONE));
 					}
 
-					// Add a watch to get a notification on data arriving.
-					Glib::signal_io().connect(sigc::mem_fun(this, &GameState::handle_io_ready), sock, Glib::IO_IN);
+#ifdef SO_RXQ_OVFL
+					// Ask the kernel to report how many datagrams it has dropped for want of buffer space, but carry on without the count if it cannot.
+					setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &ONE, sizeof(ONE));
+#endif
 
 					// Drop the socket into the vector.
-					sockets.push_back(std::move(sock));
+					receivers.emplace_back(std::move(sock));
 				} catch (const SystemError &exp) {
 					std::cerr << Glib::ustring::compose(u8"Failed to create socket for bind address %1 and port %2: %3", Glib::locale_to_utf8(host), Glib::locale_to_utf8(serv), Glib::locale_to_utf8(exp.what()));
 				}
 			}
 		}
 	}
+
+	// Take over packets from the receive thread in the main loop.
+	dispatcher.connect(sigc::mem_fun(this, &GameState::handle_pending));
 }
 
-bool GameState::handle_io_ready(Glib::IOCondition) {
-	uint8_t buffer[65536];
-	bool updated = false;
-	for (const Socket &sock : sockets) {
-		ssize_t rc = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT | MSG_NOSIGNAL);
+std::size_t GameState::receive_batch(Receiver &receiver) {
+	std::size_t count = 0;
+#ifdef __linux__
+	// Read as many datagrams as are queued, up to a whole batch, with one system call.
+	for (std::size_t i = 0; i < BATCH_SIZE; ++i) {
+		msgs[i].msg_hdr.msg_control = &controls[i * CMSG_SPACE(sizeof(uint32_t))];
+		msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+		msgs[i].msg_hdr.msg_flags = 0;
+	}
+	int rc = recvmmsg(receiver.sock, &msgs[0], static_cast<unsigned int>(BATCH_SIZE), MSG_DONTWAIT, 0);
+	if (rc < 0) {
+		int err = errno;
+		if (err != EWOULDBLOCK && err != EAGAIN && err != EINTR) {
+			std::cerr << Glib::ustring::compose(u8"Cannot receive data on socket: %1\n", Glib::locale_to_utf8(std::strerror(err)));
+		}
+		return 0;
+	}
+	count = static_cast<std::size_t>(rc);
+	for (std::size_t i = 0; i < count; ++i) {
+		lengths[i] = msgs[i].msg_len;
+		truncated[i] = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || lengths[i] > MAX_PACKET_SIZE;
+#ifdef SO_RXQ_OVFL
+		for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+				// The count runs from when the socket was opened and wraps around.
+				uint32_t drops;
+				std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+				stats.dropped += static_cast<uint32_t>(drops - receiver.kernel_drops);
+				receiver.kernel_drops = drops;
+			}
+		}
+#endif
+	}
+#else
+	// Without recvmmsg, read the queued datagrams one at a time.
+	while (count < BATCH_SIZE) {
+		ssize_t rc = recv(receiver.sock, reinterpret_cast<char *>(&buffers[count * (MAX_PACKET_SIZE + 1)]), MAX_PACKET_SIZE + 1, MSG_DONTWAIT);
 		if (rc < 0) {
-			if (errno != EWOULDBLOCK && errno != EAGAIN) {
-				throw SystemError("Cannot receive data on socket");
+			int err = errno;
+			if (err != EWOULDBLOCK && err != EAGAIN && err != EINTR) {
+				std::cerr << Glib::ustring::compose(u8"Cannot receive data on socket: %1\n", Glib::locale_to_utf8(std::strerror(err)));
 			}
+			break;
 		}
-		if (!referee.ParseFromArray(buffer, static_cast<int>(rc))) {
-			throw std::runtime_error("Error parsing Protobuf packet");
+		lengths[count] = static_cast<std::size_t>(rc);
+		truncated[count] = lengths[count] > MAX_PACKET_SIZE;
+		++count;
+	}
+#endif
+	stats.received += count;
+	return count;
+}
+
+bool GameState::drain(Receiver &receiver) {
+	bool found = false;
+	std::size_t count;
+	do {
+		count = receive_batch(receiver);
+
+		// Only the newest packet matters, so try the batch from the newest end and stop at the first that parses.
+		// Everything older, including a packet kept from an earlier batch, is superseded.
+		for (std::size_t i = count; i--;) {
+			if (truncated[i] || !candidate.ParseFromArray(&buffers[i * (MAX_PACKET_SIZE + 1)], static_cast<int>(lengths[i]))) {
+				++stats.malformed;
+				continue;
+			}
+			stats.superseded += i + (found ? 1 : 0);
+			incoming.Swap(&candidate);
+			found = true;
+			break;
+		}
+	} while (count == BATCH_SIZE);
+	return found;
+}
+
+void GameState::report_statistics() {
+	if (stats.malformed == reported_stats.malformed && stats.dropped == reported_stats.dropped) {
+		return;
+	}
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - last_report < std::chrono::seconds(10)) {
+		return;
+	}
+	std::cerr << Glib::ustring::compose(u8"Discarded %1 malformed packets and lost %2 to a full socket buffer; %3 received, of which %4 were superseded by newer ones.\n", stats.malformed - reported_stats.malformed, stats.dropped - reported_stats.dropped, stats.received - reported_stats.received, stats.superseded - reported_stats.superseded);
+	reported_stats = stats;
+	last_report = now;
+}
+
+void GameState::receive(Receiver &receiver) {
+	bool found = drain(receiver);
+	bool wake = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (found) {
+			// Packets may arrive over more than one address family; show whichever was sent last.
+			if (!have_pending) {
+				pending.Swap(&incoming);
+				have_pending = true;
+
+				// Wake the main loop only when there was nothing waiting; otherwise the wakeup for the earlier packet will find this one.
+				wake = true;
+			} else {
+				// Either the packet still waiting or this one is superseded.
+				if (incoming.packet_timestamp() >= pending.packet_timestamp()) {
+					pending.Swap(&incoming);
+				}
+				++stats.superseded;
+			}
 		}
-		updated = true;
+		published_stats = stats;
 	}
-	if (updated) {
-		ok = true;
-		timeout_connection.disconnect();
-		timeout_connection = Glib::signal_timeout().connect_seconds(sigc::mem_fun(this, &GameState::handle_timeout), 3);
-		signal_updated.emit();
+	report_statistics();
+	if (wake) {
+		dispatcher.emit();
 	}
-	return true;
+}
+
+void GameState::handle_pending() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!have_pending) {
+			return;
+		}
+		referee.Swap(&pending);
+		have_pending = false;
+	}
+	ok = true;
+	timeout_connection.disconnect();
+	timeout_connection = Glib::signal_timeout().connect_seconds(sigc::mem_fun(this, &GameState::handle_timeout), 3);
+	signal_updated.emit();
 }
 
 bool GameState::handle_timeout() {
@@ -1,29 +1,102 @@
 #ifndef GAMESTATE_H
 #define GAMESTATE_H
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <glibmm/iochannel.h>
+#include <glibmm/dispatcher.h>
 #include <sigc++/connection.h>
 #include <sigc++/signal.h>
 #include "referee.pb.h"
 #include "socket.h"
 
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+
+// The state of the game as last reported by one referee box.
+// Packets are read and parsed on a ReceiveThread, which must be created once every GameState exists; the newest state is then handed over to the main loop, where the public members are updated and signal_updated is emitted.
 class GameState {
 	public:
+		// Counts of datagrams since startup.
+		struct Statistics {
+			// Datagrams read from the sockets.
+			uint64_t received;
+			// Datagrams never parsed, because a newer one was read in the same wakeup.
+			uint64_t superseded;
+			// Datagrams that were truncated or failed to parse.
+			uint64_t malformed;
+			// Datagrams the kernel dropped because the socket buffer was full, where the platform reports it.
+			uint64_t dropped;
+		};
+
 		bool ok;
 		SSL_Referee referee;
 		sigc::signal<void> signal_updated;
 
 		GameState(const std::string &interface, const std::string &group, const std::string &port);
 
+		Statistics statistics() const;
+
 	private:
-		std::vector<Socket> sockets;
+		friend class ReceiveThread;
+
+		// How many datagrams to read with one system call, and the largest one kept; referee packets are far smaller.
+		static const std::size_t BATCH_SIZE = 32;
+		static const std::size_t MAX_PACKET_SIZE = 2048;
+
+		struct Receiver {
+			Socket sock;
+			// The kernel’s running count of datagrams dropped on this socket, as last reported.
+			uint32_t kernel_drops;
+
+			explicit Receiver(Socket &&sock);
+		};
+
+		std::vector<Receiver> receivers;
 		sigc::connection timeout_connection;
+		Glib::Dispatcher dispatcher;
 
-		bool handle_io_ready(Glib::IOCondition cond);
+		// The newest packet not yet taken by the main loop, and the statistics as of the last receive, guarded by the mutex.
+		mutable std::mutex mutex;
+		SSL_Referee pending;
+		bool have_pending;
+		Statistics published_stats;
+
+		// Everything below belongs to the receive thread.
+		Statistics stats, reported_stats;
+		std::chrono::steady_clock::time_point last_report;
+
+		// Receive buffers and message headers for one batch, allocated once.
+		std::vector<uint8_t> buffers;
+		std::vector<std::size_t> lengths;
+		std::vector<bool> truncated;
+#ifdef __linux__
+		std::vector<iovec> iovs;
+		std::vector<mmsghdr> msgs;
+		std::vector<uint8_t> controls;
+#endif
+		// The newest packet from the socket being drained, and a scratch message to parse into so that a bad packet cannot spoil it.
+		SSL_Referee incoming, candidate;
+
+		std::size_t receive_batch(Receiver &receiver);
+		bool drain(Receiver &receiver);
+		void report_statistics();
+		void receive(Receiver &receiver);
+		void handle_pending();
 		bool handle_timeout();
 };
 
-#endif
 
+
+inline GameState::Statistics GameState::statistics() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return published_stats;
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include "framesink.h"
+#include "gamestate.h"
+#include "imagedb.h"
+#include "noncopyable.h"
+#include "receivethread.h"
+#include "renderer.h"
+#include "socket.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <cairomm/context.h>
+#include <cairomm/refptr.h>
+#include <cairomm/surface.h>
+#include <glibmm/exception.h>
+#include <glibmm/keyfile.h>
+#include <glibmm/main.h>
+#include <glibmm/optioncontext.h>
+#include <glibmm/optionentry.h>
+#include <glibmm/optiongroup.h>
+#include <google/protobuf/stubs/common.h>
+#include <gtkmm/main.h>
+#include <pangomm/rectangle.h>
+#include <sigc++/functors/mem_fun.h>
+
+#ifndef WIN32
+#include <csignal>
+#include <glib-unix.h>
+#endif
+
+namespace {
+#ifndef WIN32
+	gboolean on_quit_signal(gpointer main_loop) {
+		g_main_loop_quit(static_cast<GMainLoop *>(main_loop));
+		return TRUE;
+	}
+#endif
+
+	// Draws the scoreboard into an image in memory whenever the game state changes, and sends that image to a sink at a fixed frame rate.
+	class FrameWriter : public NonCopyable {
+		public:
+			FrameWriter(GameState &state, Renderer &renderer, FrameSink &sink, int width, int height, unsigned int fps, Glib::RefPtr<Glib::MainLoop> main_loop);
+
+			// Throws the error that stopped the main loop, if writing a frame failed.
+			void check() const;
+
+		private:
+			Renderer &renderer;
+			FrameSink &sink;
+			Glib::RefPtr<Glib::MainLoop> main_loop;
+			std::exception_ptr error;
+			const unsigned int fps;
+			Cairo::RefPtr<Cairo::ImageSurface> surface;
+			Cairo::RefPtr<Cairo::Context> ctx;
+			// The current frame, already converted to the sink’s pixel format.
+			std::vector<uint8_t> frame;
+			std::vector<Pango::Rectangle> damage;
+			std::chrono::steady_clock::time_point start;
+			uint64_t frames_written;
+
+			void redraw(const Pango::Rectangle &rect);
+			void handle_state_updated();
+			bool handle_tick();
+	};
+
+	FrameWriter::FrameWriter(GameState &state, Renderer &renderer, FrameSink &sink, int width, int height, unsigned int fps, Glib::RefPtr<Glib::MainLoop> main_loop) :
+			renderer(renderer),
+			sink(sink),
+			main_loop(main_loop),
+			fps(fps),
+			surface(Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, width, height)),
+			ctx(Cairo::Context::create(surface)),
+			frame(static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 4),
+			start(std::chrono::steady_clock::now()),
+			frames_written(0) {
+		renderer.set_bounds(Pango::Rectangle(0, 0, width, height));
+		redraw(Pango::Rectangle(0, 0, width, height));
+		state.signal_updated.connect(sigc::mem_fun(this, &FrameWriter::handle_state_updated));
+
+		// The timer only approximates the frame rate; each tick writes however many frames are due, so the stream keeps pace with real time.
+		Glib::signal_timeout().connect(sigc::mem_fun(this, &FrameWriter::handle_tick), 1000U / fps > 0 ? 1000U / fps : 1U);
+	}
+
+	void FrameWriter::check() const {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	void FrameWriter::redraw(const Pango::Rectangle &rect) {
+		renderer.draw(ctx, rect);
+		surface->flush();
+
+		// Cairo stores each pixel as a native-endian 32-bit word with red in bits 16–23, green in bits 8–15, and blue in bits 0–7.
+		const uint8_t *data = surface->get_data();
+		const std::size_t stride = static_cast<std::size_t>(surface->get_stride());
+		const std::size_t row_bytes = static_cast<std::size_t>(surface->get_width()) * 4;
+		for (int y = rect.get_y(); y < rect.get_y() + rect.get_height(); ++y) {
+			const uint8_t *src = data + static_cast<std::size_t>(y) * stride;
+			uint8_t *dest = &frame[static_cast<std::size_t>(y) * row_bytes];
+			for (int x = rect.get_x(); x < rect.get_x() + rect.get_width(); ++x) {
+				uint32_t pixel;
+				std::memcpy(&pixel, src + static_cast<std::size_t>(x) * 4, sizeof(pixel));
+				uint8_t *out = dest + static_cast<std::size_t>(x) * 4;
+				out[0] = static_cast<uint8_t>(pixel >> 16);
+				out[1] = static_cast<uint8_t>(pixel >> 8);
+				out[2] = static_cast<uint8_t>(pixel);
+				out[3] = 0xFF;
+			}
+		}
+	}
+
+	void FrameWriter::handle_state_updated() {
+		damage.clear();
+		renderer.damage(damage);
+		for (const Pango::Rectangle &rect : damage) {
+			redraw(rect);
+		}
+	}
+
+	bool FrameWriter::handle_tick() {
+		uint64_t due = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()) * fps / 1000000U + 1U;
+
+		// If the sink stalled for more than a second, drop the backlog rather than flooding it with stale frames.
+		if (due - frames_written > fps) {
+			frames_written = due - 1U;
+		}
+		try {
+			while (frames_written < due) {
+				sink.write(&frame[0]);
+				++frames_written;
+			}
+		} catch (...) {
+			error = std::current_exception();
+			main_loop->quit();
+			return false;
+		}
+		return true;
+	}
+
+	int main_impl(int argc, char **argv) {
+		// Set the current locale.
+		std::locale::global(std::locale(""));
+
+		// Initialize the wrappers for images, text, and drawing; no display is needed.
+		Gtk::Main::init_gtkmm_internals();
+
+		// Parse the command-line arguments.
+		Glib::OptionContext option_context;
+		option_context.set_summary(u8"Runs the RoboCup Small Size League Scoreboard without a window, writing raw RGBA video frames for a stream encoder.");
+		option_context.set_description(u8"The Referee Box is © RoboCup Federation, 2013–2013.");
+
+		Glib::OptionGroup option_group(u8"scoreboard", u8"Scoreboard Options", u8"Show Scoreboard Options");
+
+		Glib::OptionEntry mc_interface_entry;
+		mc_interface_entry.set_long_name(u8"interface");
+		mc_interface_entry.set_short_name('i');
+		mc_interface_entry.set_description(u8"Sets the network interface name on which packets will be received.");
+		mc_interface_entry.set_arg_description(u8"INTERFACE");
+		Glib::ustring mc_interface(u8"eth0");
+		option_group.add_entry(mc_interface_entry, mc_interface);
+
+		Glib::OptionEntry mc_group_entry;
+		mc_group_entry.set_long_name(u8"group");
+		mc_group_entry.set_short_name('g');
+		mc_group_entry.set_description(u8"Sets the multicast group to join.");
+		mc_group_entry.set_arg_description(u8"ADDRESS");
+		Glib::ustring mc_group(u8"224.5.23.1");
+		option_group.add_entry(mc_group_entry, mc_group);
+
+		Glib::OptionEntry mc_port_entry;
+		mc_port_entry.set_long_name(u8"port");
+		mc_port_entry.set_short_name('p');
+		mc_port_entry.set_description(u8"Sets the UDP port on which packets will be received.");
+		mc_port_entry.set_arg_description(u8"PORT");
+		Glib::ustring mc_port(u8"10003");
+		option_group.add_entry(mc_port_entry, mc_port);
+
+		Glib::OptionEntry width_entry;
+		width_entry.set_long_name(u8"width");
+		width_entry.set_description(u8"Sets the width of the frames in pixels (defaults to 1920).");
+		width_entry.set_arg_description(u8"PIXELS");
+		int width = 1920;
+		option_group.add_entry(width_entry, width);
+
+		Glib::OptionEntry height_entry;
+		height_entry.set_long_name(u8"height");
+		height_entry.set_description(u8"Sets the height of the frames in pixels (defaults to 1080).");
+		height_entry.set_arg_description(u8"PIXELS");
+		int height = 1080;
+		option_group.add_entry(height_entry, height);
+
+		Glib::OptionEntry fps_entry;
+		fps_entry.set_long_name(u8"fps");
+		fps_entry.set_description(u8"Sets how many frames to write per second (defaults to 25).");
+		fps_entry.set_arg_description(u8"RATE");
+		int fps = 25;
+		option_group.add_entry(fps_entry, fps);
+
+		Glib::OptionEntry output_entry;
+		output_entry.set_long_name(u8"output");
+		output_entry.set_short_name('o');
+		output_entry.set_description(u8"Writes the frames one after another to a file or FIFO, or to standard output if “-” (the default).");
+		output_entry.set_arg_description(u8"FILE");
+		std::string output_filename("-");
+		option_group.add_entry_filename(output_entry, output_filename);
+
+#ifndef WIN32
+		Glib::OptionEntry shm_entry;
+		shm_entry.set_long_name(u8"shm");
+		shm_entry.set_description(u8"Writes the frames into a ring in a POSIX shared memory object instead, such as /scoreboard.");
+		shm_entry.set_arg_description(u8"NAME");
+		std::string shm_name;
+		option_group.add_entry_filename(shm_entry, shm_name);
+
+		Glib::OptionEntry shm_slots_entry;
+		shm_slots_entry.set_long_name(u8"shm-slots");
+		shm_slots_entry.set_description(u8"Sets how many frames the shared memory ring holds (defaults to 4).");
+		shm_slots_entry.set_arg_description(u8"COUNT");
+		int shm_slots = 4;
+		option_group.add_entry(shm_slots_entry, shm_slots);
+#endif
+
+		option_context.set_main_group(option_group);
+		option_context.parse(argc, argv);
+		if (width <= 0 || height <= 0 || fps <= 0) {
+			throw std::runtime_error("The frame size and rate must be positive.");
+		}
+
+		// Load configuration file.
+		Glib::KeyFile kf;
+		kf.load_from_file("scoreboard.conf");
+
+		// Index the flags and logos; each image is loaded only when its team appears.
+		ImageDatabase flags("flags");
+		ImageDatabase logos("logos");
+
+		// Open the frame sink; an encoder that exits should stop the scoreboard with an error, not a signal.
+		std::unique_ptr<FrameSink> sink;
+#ifndef WIN32
+		std::signal(SIGPIPE, SIG_IGN);
+		if (!shm_name.empty()) {
+			if (shm_slots < 2) {
+				throw std::runtime_error("The shared memory ring must hold at least two frames.");
+			}
+			sink.reset(new ShmFrameSink(shm_name, static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint32_t>(shm_slots)));
+		}
+#endif
+		if (!sink) {
+			sink.reset(new PipeFrameSink(output_filename, static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 4));
+		}
+
+		// Start receiving and updating game state.
+		Socket::init_system();
+		GameState state(mc_interface, mc_group, mc_port);
+		ReceiveThread receive_thread({&state});
+
+		// Render frames until asked to stop.
+		{
+			Glib::RefPtr<Glib::MainLoop> main_loop = Glib::MainLoop::create();
+			Renderer renderer(state, flags, logos, kf);
+			FrameWriter writer(state, renderer, *sink, width, height, static_cast<unsigned int>(fps), main_loop);
+#ifndef WIN32
+			g_unix_signal_add(SIGINT, &on_quit_signal, main_loop->gobj());
+			g_unix_signal_add(SIGTERM, &on_quit_signal, main_loop->gobj());
+#endif
+			main_loop->run();
+			writer.check();
+		}
+
+		// Shut down protobuf.
+		google::protobuf::ShutdownProtobufLibrary();
+
+		return 0;
+	}
+
+	void print_exception(const Glib::Exception &exp) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+	}
+
+	void print_exception(const std::exception &exp, bool first = true) {
+		if (first) {
+			std::cerr << "\nUnhandled exception:\n";
+		} else {
+			std::cerr << "Caused by:\n";
+		}
+		std::cerr << "Type:   " << typeid(exp).name() << '\n';
+		std::cerr << "Detail: " << exp.what() << '\n';
+		try {
+			std::rethrow_if_nested(exp);
+		} catch (const std::exception &exp) {
+			print_exception(exp, false);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	try {
+		return main_impl(argc, argv);
+	} catch (const Glib::Exception &exp) {
+		print_exception(exp);
+	} catch (const std::exception &exp) {
+		print_exception(exp);
+	} catch (...) {
+		std::cerr << "\nUnhandled exception:\n";
+		std::cerr << "Type:   Unknown\n";
+		std::cerr << "Detail: Unknown\n";
+	}
+	return 1;
+}
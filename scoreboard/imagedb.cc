@@ -1,19 +1,101 @@
 #include "imagedb.h"
+#include <algorithm>
+#include <iostream>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glibmm/convert.h>
+#include <glibmm/error.h>
 #include <glibmm/fileutils.h>
 #include <glibmm/miscutils.h>
-#include <glibmm/convert.h>
 
-image_database_t load_image_database(const std::string &path) {
-	image_database_t db;
+ImageDatabase::ImageDatabase(const std::string &path) {
 	Glib::Dir dir(path);
 	for (std::string file : dir) {
-		const std::string &full_path = Glib::build_filename(path, file);
-		if (full_path.size() > 4 && full_path[full_path.size() - 4] == '.' && full_path[full_path.size() - 3] == 'p' && full_path[full_path.size() - 2] == 'n' && full_path[full_path.size() - 1] == 'g') {
-			Glib::RefPtr<Gdk::Pixbuf> pb(Gdk::Pixbuf::create_from_file(full_path));
+		if (file.size() > 4 && file.compare(file.size() - 4, 4, ".png") == 0) {
+			const std::string &full_path = Glib::build_filename(path, file);
 			file.erase(file.end() - 4, file.end());
-			db[Glib::filename_to_utf8(file).casefold_collate_key()] = pb;
+			files[Glib::filename_to_utf8(file).casefold_collate_key()] = File{full_path, false, false, 0, 0};
+		}
+	}
+}
+
+bool ImageDatabase::size(const Glib::ustring &team, int &width, int &height) {
+	File *file = probe(team);
+	if (!file) {
+		return false;
+	}
+	width = file->width;
+	height = file->height;
+	return true;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ImageDatabase::get(const Glib::ustring &team, int width, int height) {
+	if (width <= 0 || height <= 0) {
+		return Glib::RefPtr<Gdk::Pixbuf>();
+	}
+	File *file = probe(team);
+	if (!file) {
+		return Glib::RefPtr<Gdk::Pixbuf>();
+	}
+	const std::string &key = team.casefold_collate_key();
+	Glib::RefPtr<Gdk::Pixbuf> image = lookup(scaled, key, width, height);
+	if (!image) {
+		Glib::RefPtr<Gdk::Pixbuf> full = original(key, *file);
+		if (!full) {
+			return full;
+		}
+		double xscale = static_cast<double>(width) / full->get_width();
+		double yscale = static_cast<double>(height) / full->get_height();
+		double scale = std::min(xscale, yscale);
+		image = full->scale_simple(std::max(1, std::min(width, static_cast<int>(full->get_width() * scale))), std::max(1, std::min(height, static_cast<int>(full->get_height() * scale))), Gdk::INTERP_BILINEAR);
+		insert(scaled, SCALED_CAPACITY, key, width, height, image);
+	}
+	return image;
+}
+
+ImageDatabase::File *ImageDatabase::probe(const Glib::ustring &team) {
+	auto iter = files.find(team.casefold_collate_key());
+	if (iter == files.end()) {
+		return nullptr;
+	}
+	File &file = iter->second;
+	if (!file.probed) {
+		file.probed = true;
+		file.usable = !!gdk_pixbuf_get_file_info(file.path.c_str(), &file.width, &file.height) && file.width > 0 && file.height > 0;
+		if (!file.usable) {
+			std::cerr << Glib::ustring::compose(u8"Ignoring image \"%1\", which is not a readable image file.\n", Glib::filename_to_utf8(file.path));
+		}
+	}
+	return file.usable ? &file : nullptr;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ImageDatabase::original(const std::string &key, File &file) {
+	Glib::RefPtr<Gdk::Pixbuf> image = lookup(originals, key, 0, 0);
+	if (!image) {
+		try {
+			image = Gdk::Pixbuf::create_from_file(file.path);
+		} catch (const Glib::Error &exp) {
+			std::cerr << Glib::ustring::compose(u8"Ignoring image \"%1\": %2\n", Glib::filename_to_utf8(file.path), exp.what());
+			file.usable = false;
+			return image;
 		}
+		insert(originals, ORIGINALS_CAPACITY, key, 0, 0, image);
 	}
-	return db;
+	return image;
 }
 
+Glib::RefPtr<Gdk::Pixbuf> ImageDatabase::lookup(std::list<Entry> &list, const std::string &key, int width, int height) {
+	for (auto i = list.begin(), iend = list.end(); i != iend; ++i) {
+		if (i->key == key && i->width == width && i->height == height) {
+			list.splice(list.begin(), list, i);
+			return i->image;
+		}
+	}
+	return Glib::RefPtr<Gdk::Pixbuf>();
+}
+
+void ImageDatabase::insert(std::list<Entry> &list, std::size_t capacity, const std::string &key, int width, int height, Glib::RefPtr<Gdk::Pixbuf> image) {
+	list.push_front(Entry{key, width, height, image});
+	while (list.size() > capacity) {
+		list.pop_back();
+	}
+}
@@ -1,14 +1,57 @@
 #ifndef IMAGEDB_H
 #define IMAGEDB_H
 
+#include "noncopyable.h"
+#include <cstddef>
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <gdkmm/pixbuf.h>
 #include <glibmm/refptr.h>
-#include <unordered_map>
+#include <glibmm/ustring.h>
+
+// A directory of PNG images named after teams.
+// Only the file names are read at startup; an image is decoded when its team is first drawn, and scaled copies are kept in a small least-recently-used cache.
+class ImageDatabase : public NonCopyable {
+	public:
+		explicit ImageDatabase(const std::string &path);
+
+		// Finds the natural size of a team’s image by reading only its header, returning false if the team has no usable image.
+		bool size(const Glib::ustring &team, int &width, int &height);
+
+		// Returns a team’s image scaled to fit within a box while keeping its aspect ratio, or a null pointer if there is none.
+		Glib::RefPtr<Gdk::Pixbuf> get(const Glib::ustring &team, int width, int height);
+
+	private:
+		// How many full-size images to keep decoded, enough for both teams on each of four fields, and how many scaled copies to keep, enough for every image on screen at a couple of sizes.
+		static const std::size_t ORIGINALS_CAPACITY = 8;
+		static const std::size_t SCALED_CAPACITY = 32;
+
+		struct File {
+			std::string path;
+			bool probed;
+			bool usable;
+			int width, height;
+		};
+
+		// A decoded image, keyed by team and by the box it was scaled to fit, with zero meaning full size.
+		struct Entry {
+			std::string key;
+			int width, height;
+			Glib::RefPtr<Gdk::Pixbuf> image;
+		};
+
+		std::unordered_map<std::string, File> files;
+		// Each list holds only a handful of entries, most recently used first.
+		std::list<Entry> originals, scaled;
 
-typedef std::unordered_map<std::string, Glib::RefPtr<Gdk::Pixbuf>> image_database_t;
+		// Finds an entry and moves it to the front of its list, returning a null pointer if it is absent.
+		static Glib::RefPtr<Gdk::Pixbuf> lookup(std::list<Entry> &list, const std::string &key, int width, int height);
+		static void insert(std::list<Entry> &list, std::size_t capacity, const std::string &key, int width, int height, Glib::RefPtr<Gdk::Pixbuf> image);
 
-image_database_t load_image_database(const std::string &path);
+		File *probe(const Glib::ustring &team);
+		Glib::RefPtr<Gdk::Pixbuf> original(const std::string &key, File &file);
+};
 
 #endif
 
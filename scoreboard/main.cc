@@ -1,20 +1,35 @@
 #include "gamestate.h"
 #include "imagedb.h"
 #include "mainwindow.h"
+#include "receivethread.h"
 #include "socket.h"
 #include <exception>
 #include <iostream>
 #include <locale>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 #include <glibmm/convert.h>
 #include <glibmm/exception.h>
 #include <glibmm/keyfile.h>
 #include <glibmm/optioncontext.h>
 #include <glibmm/optionentry.h>
 #include <glibmm/optiongroup.h>
+#include <glibmm/ustring.h>
 #include <google/protobuf/stubs/common.h>
 #include <gtkmm/main.h>
 
 namespace {
+	// Splits a field given as GROUP:PORT at its last colon, so that IPv6 groups work too.
+	void parse_field(const Glib::ustring &field, Glib::ustring &group, Glib::ustring &port) {
+		Glib::ustring::size_type colon = field.rfind(':');
+		if (colon == Glib::ustring::npos || colon == 0 || colon + 1 == field.size()) {
+			throw std::runtime_error(Glib::locale_from_utf8(Glib::ustring::compose(u8"Field \"%1\" is not of the form GROUP:PORT.", field)));
+		}
+		group = field.substr(0, colon);
+		port = field.substr(colon + 1);
+	}
+
 	int main_impl(int argc, char **argv) {
 		// Set the current locale.
 		std::locale::global(std::locale(""));
@@ -50,6 +65,14 @@ namespace {
 		Glib::ustring mc_port(u8"10003");
 		option_group.add_entry(mc_port_entry, mc_port);
 
+		Glib::OptionEntry field_entry;
+		field_entry.set_long_name(u8"field");
+		field_entry.set_short_name('f');
+		field_entry.set_description(u8"Shows the game from a referee box sending to a multicast group and port, such as 224.5.23.1:10003; give once per field to show several side by side (defaults to the group and port above).");
+		field_entry.set_arg_description(u8"GROUP:PORT");
+		std::vector<Glib::ustring> fields;
+		option_group.add_entry(field_entry, fields);
+
 		option_context.set_main_group(option_group);
 		Gtk::Main kit(argc, argv, option_context);
 
@@ -57,16 +80,30 @@ namespace {
 		Glib::KeyFile kf;
 		kf.load_from_file("scoreboard.conf");
 
-		// Load the flags and logos.
-		const image_database_t &flags = load_image_database("flags");
-		const image_database_t &logos = load_image_database("logos");
+		// Index the flags and logos; each image is loaded only when its team appears.
+		ImageDatabase flags("flags");
+		ImageDatabase logos("logos");
 
-		// Start receiving and updating game state.
+		// Start receiving and updating game state for each field, all on one receive thread.
 		Socket::init_system();
-		GameState state(mc_interface, mc_group, mc_port);
+		std::vector<std::unique_ptr<GameState>> states;
+		std::vector<GameState *> state_ptrs;
+		if (fields.empty()) {
+			states.emplace_back(new GameState(mc_interface, mc_group, mc_port));
+		} else {
+			for (const Glib::ustring &field : fields) {
+				Glib::ustring group, port;
+				parse_field(field, group, port);
+				states.emplace_back(new GameState(mc_interface, group, port));
+			}
+		}
+		for (const std::unique_ptr<GameState> &state : states) {
+			state_ptrs.push_back(state.get());
+		}
+		ReceiveThread receive_thread(state_ptrs);
 
 		// Create and display a main window.
-		MainWindow main_window(state, flags, logos, kf);
+		MainWindow main_window(state_ptrs, flags, logos, kf);
 		kit.run(main_window);
 
         // Shut down protobuf.
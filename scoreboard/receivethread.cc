@@ -0,0 +1,125 @@
+#include "receivethread.h"
+#include "exception.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <glibmm/convert.h>
+#include <glibmm/ustring.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#elif defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <poll.h>
+#endif
+
+namespace {
+#if !defined(__linux__)
+	// How long the thread may sleep before checking whether it should stop, where there is no way to wake it sooner.
+	const int POLL_TIMEOUT_MILLISECONDS = 100;
+#endif
+}
+
+ReceiveThread::ReceiveThread(const std::vector<GameState *> &states) : stopping(false) {
+	for (GameState *state : states) {
+		for (GameState::Receiver &receiver : state->receivers) {
+			watches.push_back(Watch{state, &receiver});
+		}
+	}
+
+#ifdef __linux__
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		throw SystemError("Cannot create epoll instance");
+	}
+	wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (wake_fd < 0) {
+		int err = errno;
+		close(epoll_fd);
+		throw SystemError("Cannot create eventfd", err);
+	}
+
+	// The eventfd, marked by a null pointer, wakes the thread to stop; every other event points at its watch.
+	epoll_event event;
+	std::memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	bool ok = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) == 0;
+	for (Watch &watch : watches) {
+		event.data.ptr = &watch;
+		ok = ok && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watch.receiver->sock, &event) == 0;
+	}
+	if (!ok) {
+		int err = errno;
+		close(wake_fd);
+		close(epoll_fd);
+		throw SystemError("Cannot add socket to epoll instance", err);
+	}
+#endif
+
+	thread = std::thread(&ReceiveThread::run, this);
+}
+
+ReceiveThread::~ReceiveThread() {
+	stopping.store(true, std::memory_order_relaxed);
+#ifdef __linux__
+	static const uint64_t ONE = 1;
+	if (write(wake_fd, &ONE, sizeof(ONE)) < 0) {
+		std::cerr << Glib::ustring::compose(u8"Cannot wake receive thread: %1\n", Glib::locale_to_utf8(std::strerror(errno)));
+	}
+#endif
+	thread.join();
+#ifdef __linux__
+	close(wake_fd);
+	close(epoll_fd);
+#endif
+}
+
+void ReceiveThread::run() {
+#ifdef __linux__
+	epoll_event events[16];
+	while (!stopping.load(std::memory_order_relaxed)) {
+		int count = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(*events), -1);
+		if (count < 0) {
+			if (errno != EINTR) {
+				std::cerr << Glib::ustring::compose(u8"Cannot wait for packets: %1\n", Glib::locale_to_utf8(std::strerror(errno)));
+				return;
+			}
+			continue;
+		}
+		for (int i = 0; i < count; ++i) {
+			Watch *watch = static_cast<Watch *>(events[i].data.ptr);
+			if (watch) {
+				watch->state->receive(*watch->receiver);
+			}
+		}
+	}
+#else
+#ifdef WIN32
+	std::vector<WSAPOLLFD> fds(watches.size());
+#else
+	std::vector<pollfd> fds(watches.size());
+#endif
+	for (std::size_t i = 0; i < watches.size(); ++i) {
+		fds[i].fd = watches[i].receiver->sock;
+		fds[i].events = POLLIN;
+	}
+	while (!stopping.load(std::memory_order_relaxed)) {
+#ifdef WIN32
+		int count = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), POLL_TIMEOUT_MILLISECONDS);
+#else
+		int count = poll(fds.data(), fds.size(), POLL_TIMEOUT_MILLISECONDS);
+#endif
+		for (std::size_t i = 0; count > 0 && i < fds.size(); ++i) {
+			if (fds[i].revents) {
+				watches[i].state->receive(*watches[i].receiver);
+				--count;
+			}
+		}
+	}
+#endif
+}
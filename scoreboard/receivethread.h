@@ -0,0 +1,37 @@
+#ifndef RECEIVETHREAD_H
+#define RECEIVETHREAD_H
+
+#include "gamestate.h"
+#include "noncopyable.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Waits on the sockets of any number of GameStates in one background thread, and has each GameState read its packets as they arrive.
+// On Linux the thread sleeps in epoll; elsewhere it polls the sockets, waking regularly to check whether it should stop.
+class ReceiveThread : public NonCopyable {
+	public:
+		explicit ReceiveThread(const std::vector<GameState *> &states);
+
+		// Stops the thread; the GameStates must outlive it.
+		~ReceiveThread();
+
+	private:
+		// A socket being watched, and the game it carries.
+		struct Watch {
+			GameState *state;
+			GameState::Receiver *receiver;
+		};
+
+		std::vector<Watch> watches;
+		std::atomic<bool> stopping;
+#ifdef __linux__
+		int epoll_fd;
+		int wake_fd;
+#endif
+		std::thread thread;
+
+		void run();
+};
+
+#endif
@@ -0,0 +1,368 @@
+#include "renderer.h"
+#include <algorithm>
+#include <initializer_list>
+#include <iomanip>
+#include <gdkmm/general.h>
+#include <glibmm/refptr.h>
+#include <pangomm/fontdescription.h>
+#include <pangomm/layout.h>
+
+// Set to 1 to show rectangles around layout elements.
+// Useful for debugging the rectangle calculation code.
+#define SHOW_LAYOUT 0
+
+namespace {
+	Glib::ustring format_time_deciseconds(uint64_t micros) {
+		uint64_t decis = micros / 100000U;
+		uint64_t seconds = decis / 10;
+		decis %= 10;
+		uint64_t minutes = seconds / 60;
+		seconds %= 60;
+		return Glib::ustring::compose(u8"%1:%2.%3", minutes, Glib::ustring::format(std::setw(2), std::setfill(L'0'), seconds), decis);
+	}
+
+	// Maps each protobuf stage to the stage box that is highlighted for it, or −1 for none.
+	const int PROTOBUF_TO_STAGE_MAPPING[14] = { 1, 1, 0, 2, 2, 0, 3, 3, 0, 4, 4, 0, 5, -1 };
+
+	bool intersects(const Pango::Rectangle &a, const Pango::Rectangle &b) {
+		return a.get_x() < b.get_x() + b.get_width() && b.get_x() < a.get_x() + a.get_width() && a.get_y() < b.get_y() + b.get_height() && b.get_y() < a.get_y() + a.get_height();
+	}
+
+	void split_rect_horizontal(const Pango::Rectangle &container, const std::initializer_list<Pango::Rectangle *> &rectangles, const std::initializer_list<double> &fractions) {
+		int x = container.get_x();
+		int y = container.get_y();
+		int w = container.get_width();
+		int h = container.get_height();
+		decltype(rectangles.begin()) i, iend;
+		decltype(fractions.begin()) j;
+		for (i = rectangles.begin(), iend = rectangles.end(), j = fractions.begin(); i != iend; ++i, ++j) {
+			(*i)->set_x(x);
+			(*i)->set_y(y);
+			(*i)->set_width(static_cast<int>(w * *j));
+			(*i)->set_height(h);
+			x += static_cast<int>(w * *j);
+		}
+	}
+
+	void split_rect_vertical(const Pango::Rectangle &container, const std::initializer_list<Pango::Rectangle *> &rectangles, const std::initializer_list<double> &fractions) {
+		int x = container.get_x();
+		int y = container.get_y();
+		int w = container.get_width();
+		int h = container.get_height();
+		decltype(rectangles.begin()) i, iend;
+		decltype(fractions.begin()) j;
+		for (i = rectangles.begin(), iend = rectangles.end(), j = fractions.begin(); i != iend; ++i, ++j) {
+			(*i)->set_x(x);
+			(*i)->set_y(y);
+			(*i)->set_width(w);
+			(*i)->set_height(static_cast<int>(h * *j));
+			y += static_cast<int>(h * *j);
+		}
+	}
+
+	void pad_rect(const Pango::Rectangle &outer, Pango::Rectangle &inner, int padding) {
+		inner.set_x(outer.get_x() + padding);
+		inner.set_y(outer.get_y() + padding);
+		inner.set_width(outer.get_width() - 2 * padding);
+		inner.set_height(outer.get_height() - 2 * padding);
+	}
+
+	// Draws a coloured line, as wide as the padding, midway between a rectangle and its padded interior.
+	void draw_outline(Cairo::RefPtr<Cairo::Context> ctx, const Pango::Rectangle &outer, const Pango::Rectangle &inner, int padding) {
+		ctx->set_line_width(padding);
+		ctx->rectangle((outer.get_x() + inner.get_x()) / 2, (outer.get_y() + inner.get_y()) / 2, (outer.get_width() + inner.get_width()) / 2, (outer.get_height() + inner.get_height()) / 2);
+		ctx->stroke();
+		ctx->set_line_width(1);
+	}
+
+	void draw_text(Cairo::RefPtr<Cairo::Context> ctx, const Pango::Rectangle &rect, int padding, const Glib::ustring &text) {
+		Pango::FontDescription fd;
+		fd.set_family(u8"monospace");
+		fd.set_style(Pango::STYLE_NORMAL);
+		fd.set_variant(Pango::VARIANT_NORMAL);
+		fd.set_size(24 * Pango::SCALE);
+
+		Glib::RefPtr<Pango::Layout> layout(Pango::Layout::create(ctx));
+		layout->set_text(text);
+		layout->set_font_description(fd);
+		Pango::Rectangle orig_pixel_extents = layout->get_pixel_logical_extents();
+
+		int target_width = rect.get_width() - 2 * padding;
+		int target_height = rect.get_height() - 2 * padding;
+
+		if (target_width <= 0 || target_height <= 0) {
+			return;
+		}
+
+		double xscale = static_cast<double>(target_width) / orig_pixel_extents.get_width();
+		double yscale = static_cast<double>(target_height) / orig_pixel_extents.get_height();
+		double scale = std::min(xscale, yscale);
+
+		fd.set_size(static_cast<int>(24 * Pango::SCALE * scale));
+		layout->set_font_description(fd);
+		Pango::Rectangle new_pixel_extents = layout->get_pixel_logical_extents();
+
+		ctx->move_to(rect.get_x() + padding + (target_width - new_pixel_extents.get_width()) / 2, rect.get_y() + padding + (target_height - new_pixel_extents.get_height()) / 2);
+		layout->show_in_cairo_context(ctx);
+	}
+
+	void draw_image(Cairo::RefPtr<Cairo::Context> ctx, const Pango::Rectangle &rect, int padding, Glib::RefPtr<Gdk::Pixbuf> image) {
+		Pango::Rectangle target;
+		pad_rect(rect, target, padding);
+
+		if (rect.get_width() <= 0 || rect.get_height() <= 0) {
+			return;
+		}
+
+		ctx->save();
+		ctx->translate(target.get_x() + (target.get_width() - image->get_width()) / 2, target.get_y() + (target.get_height() - image->get_height()) / 2);
+		Gdk::Cairo::set_source_pixbuf(ctx, image, 0, 0);
+		ctx->paint();
+		ctx->restore();
+	}
+}
+
+Renderer::Renderer(const GameState &state, ImageDatabase &flags, ImageDatabase &logos, const Glib::KeyFile &config) :
+		state(state),
+		flags(flags),
+		logos(logos),
+		config(config),
+		padding(0),
+		drawn_ok(false) {
+}
+
+void Renderer::set_bounds(const Pango::Rectangle &new_bounds) {
+	if (new_bounds.get_x() == bounds.get_x() && new_bounds.get_y() == bounds.get_y() && new_bounds.get_width() == bounds.get_width() && new_bounds.get_height() == bounds.get_height()) {
+		return;
+	}
+	bounds = new_bounds;
+
+	// Compute how big a padding area should be (2% of whichever dimension is smaller).
+	padding = std::min(bounds.get_width(), bounds.get_height()) / 50;
+
+	// Compute a rectangle that will hold each part of the display.
+	// bounds
+		Pango::Rectangle top_rect, bottom_rect;
+		split_rect_vertical(bounds, {&top_rect, &bottom_rect}, {0.2, 0.8});
+		// top_rect
+			split_rect_horizontal(top_rect, {&regions[CLOCK_REGION].rect, &regions[STAGES_REGION].rect}, {0.7, 0.3});
+			// clock region is terminal
+			// stages region
+				Pango::Rectangle stages_top_rect, stages_bottom_rect;
+				split_rect_vertical(regions[STAGES_REGION].rect, {&stages_top_rect, &stages_bottom_rect}, {0.5, 0.5});
+				// stages_top_rect
+					split_rect_horizontal(stages_top_rect, {&stage_rects[0], &stage_rects[1], &stage_rects[2]}, {0.333, 0.333, 0.334});
+					// these are terminal
+				// stages_bottom_rect
+					split_rect_horizontal(stages_bottom_rect, {&stage_rects[3], &stage_rects[4], &stage_rects[5]}, {0.333, 0.333, 0.334});
+					// these are terminal
+		// bottom_rect
+			split_rect_horizontal(bottom_rect, {&regions[YELLOW_REGION].rect, &regions[BLUE_REGION].rect}, {0.5, 0.5});
+			// team regions
+				pad_rect(regions[YELLOW_REGION].rect, yellow_inner_rect, padding);
+				pad_rect(regions[BLUE_REGION].rect, blue_inner_rect, padding);
+
+	// Every region must be redrawn at its new size.
+	for (Region &region : regions) {
+		region.surface.clear();
+	}
+}
+
+bool Renderer::damage(std::vector<Pango::Rectangle> &rects) {
+	// Switching to or from the no-signal message changes everything; otherwise only the regions whose contents changed need repainting.
+	std::size_t old_size = rects.size();
+	if (state.ok != drawn_ok) {
+		drawn_ok = state.ok;
+		rects.push_back(bounds);
+	} else if (state.ok) {
+		for (std::size_t i = 0; i < REGION_COUNT; ++i) {
+			const Region &region = regions[i];
+			if (region.surface && region.key != region_key(i)) {
+				rects.push_back(region.rect);
+			}
+		}
+	}
+	return rects.size() != old_size;
+}
+
+void Renderer::draw(Cairo::RefPtr<Cairo::Context> ctx, const Pango::Rectangle &area) {
+	// Draw only within the area, filling the background with black.
+	ctx->save();
+	ctx->rectangle(area.get_x(), area.get_y(), area.get_width(), area.get_height());
+	ctx->clip();
+	ctx->rectangle(bounds.get_x(), bounds.get_y(), bounds.get_width(), bounds.get_height());
+	ctx->clip();
+	ctx->set_source_rgb(0.0, 0.0, 0.0);
+	ctx->paint();
+
+	// If the current data is not valid, just show a big message and stop.
+	drawn_ok = state.ok;
+	if (!state.ok) {
+		ctx->set_source_rgb(1.0, 1.0, 1.0);
+		draw_text(ctx, bounds, padding, u8"No Signal");
+		ctx->restore();
+		return;
+	}
+
+	// Redraw the surface of each region in the area if what it shows has changed, then copy it to the target.
+	for (std::size_t i = 0; i < REGION_COUNT; ++i) {
+		Region &region = regions[i];
+		if (region.rect.get_width() <= 0 || region.rect.get_height() <= 0 || !intersects(region.rect, area)) {
+			continue;
+		}
+		const Glib::ustring &key = region_key(i);
+		if (!region.surface || region.key != key) {
+			if (!region.surface) {
+				region.surface = ctx->get_target()->create_similar(Cairo::CONTENT_COLOR, region.rect.get_width(), region.rect.get_height());
+			}
+			Cairo::RefPtr<Cairo::Context> region_ctx = Cairo::Context::create(region.surface);
+			region_ctx->set_source_rgb(0.0, 0.0, 0.0);
+			region_ctx->paint();
+			region_ctx->translate(-region.rect.get_x(), -region.rect.get_y());
+			region.key = key;
+			draw_region(i, region_ctx);
+		}
+		ctx->set_source(region.surface, region.rect.get_x(), region.rect.get_y());
+		ctx->rectangle(region.rect.get_x(), region.rect.get_y(), region.rect.get_width(), region.rect.get_height());
+		ctx->fill();
+	}
+
+#if SHOW_LAYOUT
+	// Show the rectangles making up the layout.
+	ctx->set_source_rgb(1.0, 1.0, 1.0);
+	for (const Region &region : regions) {
+		ctx->rectangle(region.rect.get_x(), region.rect.get_y(), region.rect.get_width(), region.rect.get_height());
+	}
+	ctx->stroke();
+#endif
+
+	ctx->restore();
+}
+
+Glib::ustring Renderer::region_key(std::size_t region) const {
+	switch (region) {
+		case CLOCK_REGION:
+			return state.referee.stage_time_left() < 0 ? u8"0:00.0" : format_time_deciseconds(state.referee.stage_time_left());
+
+		case STAGES_REGION:
+			return Glib::ustring::format(PROTOBUF_TO_STAGE_MAPPING[state.referee.stage()]);
+
+		case YELLOW_REGION:
+			return Glib::ustring::compose(u8"%1\n%2", state.referee.yellow().name(), state.referee.yellow().score());
+
+		case BLUE_REGION:
+			return Glib::ustring::compose(u8"%1\n%2", state.referee.blue().name(), state.referee.blue().score());
+	}
+	return Glib::ustring();
+}
+
+void Renderer::draw_region(std::size_t region, Cairo::RefPtr<Cairo::Context> ctx) {
+	switch (region) {
+		case CLOCK_REGION:
+			ctx->set_source_rgb(1.0, 1.0, 1.0);
+			draw_text(ctx, regions[CLOCK_REGION].rect, padding, regions[CLOCK_REGION].key);
+			break;
+
+		case STAGES_REGION:
+			{
+				static const Glib::ustring STAGE_TEXTS[6] = { u8"HT", u8"N1", u8"N2", u8"O1", u8"O2", u8"PS" };
+				for (int i = 0; i < 6; ++i) {
+					if (PROTOBUF_TO_STAGE_MAPPING[state.referee.stage()] == i) {
+						ctx->set_source_rgb(1.0, 1.0, 1.0);
+					} else {
+						ctx->set_source_rgb(0.2, 0.2, 0.2);
+					}
+					draw_text(ctx, stage_rects[i], padding, STAGE_TEXTS[i]);
+				}
+			}
+			break;
+
+		case YELLOW_REGION:
+			ctx->set_source_rgb(1.0, 1.0, 0.0);
+			draw_outline(ctx, regions[YELLOW_REGION].rect, yellow_inner_rect, padding);
+			draw_team_rectangle(state.referee.yellow().name(), yellow_inner_rect, ctx, padding, state.referee.yellow().score());
+			break;
+
+		case BLUE_REGION:
+			ctx->set_source_rgb(0.0, 0.0, 1.0);
+			draw_outline(ctx, regions[BLUE_REGION].rect, blue_inner_rect, padding);
+			draw_team_rectangle(state.referee.blue().name(), blue_inner_rect, ctx, padding, state.referee.blue().score());
+			break;
+	}
+}
+
+void Renderer::draw_team_rectangle(const Glib::ustring &name, Pango::Rectangle inner_rect, Cairo::RefPtr<Cairo::Context> ctx, int padding, unsigned int score) {
+	// Find the sizes of the logo and flag images for the team; the images themselves are only decoded once the layout is known.
+	int fwidth = 0, fheight = 0, lwidth = 0, lheight = 0;
+	bool logo = logos.size(name, lwidth, lheight);
+	bool flag = flags.size(name, fwidth, fheight);
+
+	// Decide whether to show the team name.
+	bool show_name = config.has_key(u8"shownames", name) ? config.get_boolean(u8"shownames", name) : !logo;
+	if (!show_name && !flag && !logo) {
+		show_name = true;
+	}
+
+	// inner_rect
+		Pango::Rectangle top_rect, score_rect;
+		split_rect_vertical(inner_rect, {&top_rect, &score_rect}, {0.6, 0.4});
+		// top_rect
+			Pango::Rectangle name_rect, images_rect, logo_rect, flag_rect;
+			if (show_name && (flag || logo)) {
+				split_rect_vertical(top_rect, {&name_rect, &images_rect}, {0.35, 0.65});
+			} else if (flag || logo) {
+				images_rect = top_rect;
+			} else {
+				name_rect = top_rect;
+			}
+			// name_rect is terminal
+			// images_rect
+				if (flag && logo) {
+					int hwidth = fwidth + lwidth, hheight = std::max(fheight, lheight);
+					int vwidth = std::max(fwidth, lwidth), vheight = fheight + lheight;
+					double hscale = std::min(static_cast<double>(images_rect.get_width()) / hwidth, static_cast<double>(images_rect.get_height()) / hheight);
+					double vscale = std::min(static_cast<double>(images_rect.get_width()) / vwidth, static_cast<double>(images_rect.get_height()) / vheight);
+					if (hscale >= vscale) {
+						split_rect_horizontal(images_rect, {&logo_rect, &flag_rect}, {0.5, 0.5});
+					} else {
+						split_rect_vertical(images_rect, {&logo_rect, &flag_rect}, {0.5, 0.5});
+					}
+					// logo_rect is terminal
+					// flag_rect is terminal
+				} else if (logo) {
+					logo_rect = images_rect;
+					// logo_rect is terminal
+				} else if (flag) {
+					flag_rect = images_rect;
+					// flag_rect is terminal
+				}
+		// score_rect is terminal
+
+#if SHOW_LAYOUT
+	// Show the rectangles making up the layout.
+	ctx->set_source_rgb(1.0, 1.0, 1.0);
+	std::initializer_list<const Pango::Rectangle *> rects{&clock_rect, &half_time_rect, &first_half_rect, &second_half_rect, &overtime_first_half_rect, &overtime_second_half_rect, &penalty_shootout_rect, &rect, &name_rect, &flag_rect, &logo_rect, &score_rect, &blue_rect, &blue_name_rect, &blue_flag_rect, &blue_logo_rect, &blue_score_rect};
+	for (auto i : rects) {
+		ctx->rectangle(i->get_x(), i->get_y(), i->get_width(), i->get_height());
+	}
+	ctx->stroke();
+#endif
+
+	ctx->set_source_rgb(1.0, 1.0, 1.0);
+	draw_text(ctx, name_rect, padding, name);
+	if (logo) {
+		const Glib::RefPtr<Gdk::Pixbuf> &image = logos.get(name, logo_rect.get_width(), logo_rect.get_height());
+		if (image) {
+			draw_image(ctx, logo_rect, padding, image);
+		}
+	}
+	if (flag) {
+		const Glib::RefPtr<Gdk::Pixbuf> &image = flags.get(name, flag_rect.get_width(), flag_rect.get_height());
+		if (image) {
+			draw_image(ctx, flag_rect, padding, image);
+		}
+	}
+	ctx->set_source_rgb(1.0, 1.0, 1.0);
+	draw_text(ctx, score_rect, padding, Glib::ustring::format(score));
+}
+
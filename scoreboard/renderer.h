@@ -0,0 +1,67 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "gamestate.h"
+#include "imagedb.h"
+#include "noncopyable.h"
+#include <cstddef>
+#include <vector>
+#include <cairomm/context.h>
+#include <cairomm/refptr.h>
+#include <cairomm/surface.h>
+#include <glibmm/keyfile.h>
+#include <glibmm/ustring.h>
+#include <pangomm/rectangle.h>
+
+// Draws the scoreboard for one game onto any Cairo context, whether a window or an image in memory.
+// The scoreboard is split into regions, each drawn onto its own surface and redrawn only when what it shows changes.
+class Renderer : public NonCopyable {
+	public:
+		Renderer(const GameState &state, ImageDatabase &flags, ImageDatabase &logos, const Glib::KeyFile &config);
+
+		// Sets the rectangle of the target to draw within, recomputing the layout if it changed.
+		void set_bounds(const Pango::Rectangle &bounds);
+
+		// Adds to a list the rectangles whose drawing no longer matches the game state, returning whether there were any.
+		bool damage(std::vector<Pango::Rectangle> &rects);
+
+		// Draws the part of the scoreboard that lies within an area of the target.
+		void draw(Cairo::RefPtr<Cairo::Context> ctx, const Pango::Rectangle &area);
+
+	private:
+		enum {
+			CLOCK_REGION,
+			STAGES_REGION,
+			YELLOW_REGION,
+			BLUE_REGION,
+			REGION_COUNT
+		};
+
+		// A part of the scoreboard that is drawn onto its own surface, which is redrawn only when what the region shows changes.
+		struct Region {
+			Pango::Rectangle rect;
+			Cairo::RefPtr<Cairo::Surface> surface;
+			// The contents last drawn onto the surface, compared against the game state to tell whether the surface is stale.
+			Glib::ustring key;
+		};
+
+		const GameState &state;
+		ImageDatabase &flags;
+		ImageDatabase &logos;
+		const Glib::KeyFile &config;
+
+		// The layout, computed for the bounds it was last drawn in.
+		Pango::Rectangle bounds;
+		int padding;
+		Region regions[REGION_COUNT];
+		Pango::Rectangle stage_rects[6], yellow_inner_rect, blue_inner_rect;
+
+		// Whether the regions, rather than the no-signal message, were last shown.
+		bool drawn_ok;
+
+		Glib::ustring region_key(std::size_t region) const;
+		void draw_region(std::size_t region, Cairo::RefPtr<Cairo::Context> ctx);
+		void draw_team_rectangle(const Glib::ustring &name, Pango::Rectangle inner_rect, Cairo::RefPtr<Cairo::Context> context, int padding, unsigned int score);
+};
+
+#endif
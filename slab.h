@@ -0,0 +1,127 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "noncopyable.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Names an object in a Slab: its slot, and the generation of the object in that slot.
+// A handle kept past its object’s removal finds nothing rather than a newcomer in the same slot.
+struct SlabHandle {
+	uint32_t slot;
+	uint32_t generation;
+};
+
+// A fixed number of objects stored in place, addressed by handles that make insertion, lookup, and removal O(1).
+template<typename T> class Slab : public NonCopyable {
+	public:
+		explicit Slab(std::size_t capacity);
+		~Slab();
+
+		std::size_t size() const;
+		std::size_t capacity() const;
+		bool full() const;
+
+		// Constructs an object in a free slot, passing its handle and then args to its constructor; the slab must not be full.
+		template<typename... Args> SlabHandle emplace(Args &&... args);
+
+		// Returns the object a handle names, or null if it has been removed.
+		T *get(SlabHandle handle);
+
+		// Returns the object in a slot, or null if the slot is free, for visiting every object.
+		T *get(uint32_t slot);
+
+		// Destroys an object; this may be done from within one of the object’s own member functions, provided it touches nothing afterwards.
+		void erase(SlabHandle handle);
+
+	private:
+		struct Slot {
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+			uint32_t generation;
+			bool live;
+		};
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> free_slots;
+
+		T *object(uint32_t slot);
+};
+
+
+
+template<typename T> Slab<T>::Slab(std::size_t capacity) : slots(capacity) {
+	free_slots.reserve(capacity);
+	for (std::size_t i = capacity; i--; ) {
+		slots[i].generation = 0;
+		slots[i].live = false;
+		free_slots.push_back(static_cast<uint32_t>(i));
+	}
+}
+
+template<typename T> Slab<T>::~Slab() {
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].live) {
+			slots[i].live = false;
+			object(i)->~T();
+		}
+	}
+}
+
+template<typename T> std::size_t Slab<T>::size() const {
+	return slots.size() - free_slots.size();
+}
+
+template<typename T> std::size_t Slab<T>::capacity() const {
+	return slots.size();
+}
+
+template<typename T> bool Slab<T>::full() const {
+	return free_slots.empty();
+}
+
+template<typename T> template<typename... Args> SlabHandle Slab<T>::emplace(Args &&... args) {
+	assert(!full());
+	uint32_t slot = free_slots.back();
+	SlabHandle handle = { slot, ++slots[slot].generation };
+	free_slots.pop_back();
+	try {
+		new(&slots[slot].storage) T(handle, std::forward<Args>(args)...);
+	} catch (...) {
+		free_slots.push_back(slot);
+		throw;
+	}
+	slots[slot].live = true;
+	return handle;
+}
+
+template<typename T> T *Slab<T>::get(SlabHandle handle) {
+	if (handle.slot < slots.size() && slots[handle.slot].live && slots[handle.slot].generation == handle.generation) {
+		return object(handle.slot);
+	}
+	return nullptr;
+}
+
+template<typename T> T *Slab<T>::get(uint32_t slot) {
+	return slots[slot].live ? object(slot) : nullptr;
+}
+
+template<typename T> void Slab<T>::erase(SlabHandle handle) {
+	if (!get(handle)) {
+		return;
+	}
+	// Mark the slot free before destroying, so that anything the destructor does sees the object as gone.
+	slots[handle.slot].live = false;
+	free_slots.push_back(handle.slot);
+	object(handle.slot)->~T();
+}
+
+template<typename T> T *Slab<T>::object(uint32_t slot) {
+	return reinterpret_cast<T *>(&slots[slot].storage);
+}
+
+#endif
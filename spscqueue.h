@@ -0,0 +1,74 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include "noncopyable.h"
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A bounded lock-free queue passing items from exactly one producer thread to exactly one consumer thread.
+template<typename T> class SPSCQueue : public NonCopyable {
+	public:
+		// Creates a queue holding at least capacity items; the capacity is rounded up to a power of two.
+		explicit SPSCQueue(std::size_t capacity);
+
+		// Adds an item; called only by the producer.
+		// Returns false, leaving the item untouched, if the queue is full.
+		bool push(T &&item);
+
+		// Removes the oldest item; called only by the consumer.
+		// Returns false if the queue is empty.
+		bool pop(T &item);
+
+	private:
+		std::vector<T> slots;
+		const std::size_t mask;
+
+		// The two ends live on separate cache lines so the producer and consumer do not contend for one.
+		// They are kept apart by padding rather than alignas, which plain new does not honour for over-aligned types before C++17.
+		std::atomic<std::size_t> head;
+		char head_padding[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> tail;
+
+		static std::size_t round_up(std::size_t capacity);
+};
+
+
+
+template<typename T> SPSCQueue<T>::SPSCQueue(std::size_t capacity) :
+		slots(round_up(capacity)),
+		mask(slots.size() - 1),
+		head(0),
+		tail(0) {
+}
+
+template<typename T> bool SPSCQueue<T>::push(T &&item) {
+	std::size_t t = tail.load(std::memory_order_relaxed);
+	if (t - head.load(std::memory_order_acquire) == slots.size()) {
+		return false;
+	}
+	slots[t & mask] = std::move(item);
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T> bool SPSCQueue<T>::pop(T &item) {
+	std::size_t h = head.load(std::memory_order_relaxed);
+	if (h == tail.load(std::memory_order_acquire)) {
+		return false;
+	}
+	item = std::move(slots[h & mask]);
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T> std::size_t SPSCQueue<T>::round_up(std::size_t capacity) {
+	std::size_t result = 1;
+	while (result < capacity) {
+		result <<= 1;
+	}
+	return result;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "statefeed.h"
+#include "savestate.pb.h"
+
+namespace {
+	bool team_changed(const SSL_Referee::TeamInfo &before, const SSL_Referee::TeamInfo &after) {
+		return before.score() != after.score()
+			|| before.red_cards() != after.red_cards()
+			|| before.yellow_cards() != after.yellow_cards()
+			|| before.yellow_card_times_size() != after.yellow_card_times_size();
+	}
+}
+
+StateFeed::StateFeed() : last_sequence(0) {
+}
+
+void StateFeed::publish(SaveState &state, unsigned int changes) {
+	const SSL_Referee &ref = state.referee();
+
+	// Work out a delta only if something a subscriber hears about might have changed and someone is listening.
+	if ((changes & ~CHANGE_CLOCKS) && !signal_delta.empty() && last.IsInitialized()) {
+		SSL_Referee delta;
+		bool changed = false;
+		delta.set_packet_timestamp(ref.packet_timestamp());
+		delta.set_command_counter(ref.command_counter());
+		if (ref.command_counter() != last.command_counter() || ref.command() != last.command()) {
+			changed = true;
+			delta.set_command(ref.command());
+			delta.set_command_timestamp(ref.command_timestamp());
+			if (ref.has_designated_position()) {
+				delta.mutable_designated_position()->CopyFrom(ref.designated_position());
+			}
+		}
+		if (ref.stage() != last.stage()) {
+			changed = true;
+			delta.set_stage(ref.stage());
+			if (ref.has_stage_time_left()) {
+				delta.set_stage_time_left(ref.stage_time_left());
+			}
+		}
+		if (team_changed(last.yellow(), ref.yellow())) {
+			changed = true;
+			delta.mutable_yellow()->CopyFrom(ref.yellow());
+		}
+		if (team_changed(last.blue(), ref.blue())) {
+			changed = true;
+			delta.mutable_blue()->CopyFrom(ref.blue());
+		}
+		if (changed) {
+			signal_delta.emit(++last_sequence, delta);
+		}
+	}
+
+	// Keep the snapshot current on every publish, clocks included, so that new subscribers start from an up-to-date packet.
+	last.CopyFrom(ref);
+}
+
+const SSL_Referee &StateFeed::snapshot() const {
+	return last;
+}
+
+uint64_t StateFeed::sequence() const {
+	return last_sequence;
+}
@@ -0,0 +1,34 @@
+#ifndef STATEFEED_H
+#define STATEFEED_H
+
+#include "noncopyable.h"
+#include "publisher.h"
+#include <cstdint>
+#include <referee.pb.h>
+#include <sigc++/signal.h>
+
+class SaveState;
+
+// Turns each published state into a compact delta for remote control subscribers, holding only the parts of the referee packet that changed.
+// A delta always has the packet timestamp and command counter; it has the command, with its timestamp and designated position, if the command changed;
+// the stage, with its time left, if the stage changed; and a team’s whole TeamInfo if that team’s score or cards changed.
+class StateFeed : public NonCopyable, public Publisher {
+	public:
+		// Emitted with each delta and its sequence number, which counts up from 1, on the publishing thread with the controller’s lock held.
+		// Handlers must only queue the delta for later; connect and disconnect them with the lock held as well.
+		sigc::signal<void, uint64_t, const SSL_Referee &> signal_delta;
+
+		StateFeed();
+		void publish(SaveState &state, unsigned int changes);
+
+		// Returns the referee packet as of the last publish, and the sequence number of the last delta made from it.
+		// A new subscriber starts from this packet and applies only deltas with higher sequence numbers; read both with the controller’s lock held.
+		const SSL_Referee &snapshot() const;
+		uint64_t sequence() const;
+
+	private:
+		SSL_Referee last;
+		uint64_t last_sequence;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "tickscheduler.h"
+#include "exception.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <glibmm/convert.h>
+#include <glibmm/ustring.h>
+
+#ifdef __linux__
+#include <ctime>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+namespace {
+	const std::chrono::seconds REPORT_INTERVAL(60);
+
+#ifdef __linux__
+	const uint32_t TIMER_ID = 0;
+	const uint32_t WAKE_ID = 1;
+	const uint32_t FIRST_WATCH_ID = 2;
+
+	timespec to_timespec(std::chrono::nanoseconds ns) {
+		timespec ts;
+		ts.tv_sec = static_cast<time_t>(ns.count() / 1000000000);
+		ts.tv_nsec = static_cast<long>(ns.count() % 1000000000);
+		return ts;
+	}
+
+	void add_to_epoll(int epoll, int fd, uint32_t id) {
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u32 = id;
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			throw SystemError("Cannot watch descriptor for tick scheduler");
+		}
+	}
+#endif
+
+	// Returns the current time on the same monotonic timeline the deadlines use.
+	std::chrono::nanoseconds monotonic_now() {
+#ifdef __linux__
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+#endif
+	}
+
+	std::size_t jitter_bucket(std::chrono::nanoseconds lateness) {
+		long long micros = std::chrono::duration_cast<std::chrono::microseconds>(lateness).count();
+		std::size_t bucket = 0;
+		while (micros > 0 && bucket < TickScheduler::JITTER_BUCKETS - 1) {
+			micros >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	// Returns the upper bound, in microseconds, of the bucket holding the given fraction of ticks.
+	long long jitter_percentile(const TickScheduler::Statistics &stats, double fraction) {
+		uint64_t wanted = static_cast<uint64_t>(static_cast<double>(stats.ticks) * fraction);
+		uint64_t seen = 0;
+		for (std::size_t i = 0; i < TickScheduler::JITTER_BUCKETS - 1; ++i) {
+			seen += stats.jitter[i];
+			if (seen >= wanted) {
+				return 1LL << i;
+			}
+		}
+		return stats.max_jitter.count();
+	}
+
+	// Returns the period unchanged if it is positive, so the constructor rejects a bad one before dividing by it.
+	std::chrono::microseconds positive_period(std::chrono::microseconds period) {
+		if (period.count() <= 0) {
+			throw std::invalid_argument("Tick period must be positive");
+		}
+		return period;
+	}
+}
+
+TickScheduler::TickScheduler(Logger &logger, std::chrono::microseconds period, const std::function<void()> &on_tick) :
+		period(positive_period(period)),
+		on_tick(on_tick),
+		logger(logger),
+#ifdef __linux__
+		epoll(epoll_create1(EPOLL_CLOEXEC), "Cannot create epoll instance for tick scheduler"),
+		timer(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK), "Cannot create tick timer"),
+		wake(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "Cannot create tick scheduler wakeup event"),
+#else
+		stopping(false),
+#endif
+		next_deadline(0),
+		total(),
+		window(),
+		ticks_per_report(std::max<uint64_t>(1, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(REPORT_INTERVAL).count() / this->period.count()))) {
+#ifdef __linux__
+	add_to_epoll(epoll, timer, TIMER_ID);
+	add_to_epoll(epoll, wake, WAKE_ID);
+#endif
+}
+
+TickScheduler::~TickScheduler() {
+	stop();
+}
+
+void TickScheduler::watch(int fd, const std::function<void()> &on_ready) {
+#ifdef __linux__
+	add_to_epoll(epoll, fd, static_cast<uint32_t>(FIRST_WATCH_ID + watches.size()));
+	watches.push_back(Watch{fd, on_ready});
+#else
+	static_cast<void>(fd);
+	static_cast<void>(on_ready);
+#endif
+}
+
+void TickScheduler::start() {
+	next_deadline = monotonic_now() + period;
+#ifdef __linux__
+	// Arm the timer against absolute deadlines: the kernel computes each expiry from the first one, so lateness in handling one tick never delays the next.
+	itimerspec spec;
+	spec.it_value = to_timespec(next_deadline);
+	spec.it_interval = to_timespec(period);
+	if (timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+		throw SystemError("Cannot arm tick timer");
+	}
+#else
+	stopping = false;
+#endif
+	thread = std::thread(&TickScheduler::run, this);
+}
+
+void TickScheduler::stop() {
+	if (!thread.joinable()) {
+		return;
+	}
+#ifdef __linux__
+	uint64_t one = 1;
+	if (write(wake, &one, sizeof(one)) < 0) {
+		// The event counter can only fail to accept a write if it would overflow, in which case it is already readable.
+	}
+#else
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	cond.notify_all();
+#endif
+	thread.join();
+#ifdef __linux__
+	// Reset the event counter, or a later start would see the stop request again and exit at once.
+	uint64_t count;
+	if (read(wake, &count, sizeof(count)) < 0) {
+		// The counter is non-blocking and was just written, so it can only be empty if the write itself failed because it was already full.
+	}
+#endif
+	report_stats(statistics(), u8"since start");
+}
+
+TickScheduler::Statistics TickScheduler::statistics() const {
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	return total;
+}
+
+void TickScheduler::run() {
+#ifdef __linux__
+	std::array<epoll_event, 8> events;
+	for (;;) {
+		int count = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), -1);
+		if (count < 0) {
+			int rc = errno;
+			if (rc == EINTR) {
+				continue;
+			}
+			logger.write(Glib::ustring::compose(u8"Tick scheduler stopped: %1", Glib::locale_to_utf8(std::strerror(rc))));
+			return;
+		}
+		for (int i = 0; i < count; ++i) {
+			uint32_t id = events[static_cast<std::size_t>(i)].data.u32;
+			if (id == WAKE_ID) {
+				return;
+			} else if (id == TIMER_ID) {
+				// The timer reports how many deadlines passed since it was last read; more than one means ticks were missed.
+				uint64_t expirations;
+				if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations) || !expirations) {
+					continue;
+				}
+				next_deadline += period * static_cast<std::chrono::microseconds::rep>(expirations - 1);
+				record(monotonic_now() - next_deadline, expirations - 1);
+				next_deadline += period;
+				on_tick();
+			} else {
+				watches[id - FIRST_WATCH_ID].on_ready();
+			}
+		}
+	}
+#else
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		std::chrono::steady_clock::time_point deadline(std::chrono::duration_cast<std::chrono::steady_clock::duration>(next_deadline));
+		if (cond.wait_until(lock, deadline, [this]() { return stopping; })) {
+			return;
+		}
+		// If more than one deadline passed while we slept, skip the ones we missed so the schedule stays on its original grid.
+		std::chrono::nanoseconds now = monotonic_now();
+		uint64_t missed = static_cast<uint64_t>((now - next_deadline) / period);
+		next_deadline += period * static_cast<std::chrono::microseconds::rep>(missed);
+		record(now - next_deadline, missed);
+		next_deadline += period;
+		lock.unlock();
+		on_tick();
+		lock.lock();
+	}
+#endif
+}
+
+void TickScheduler::record(std::chrono::nanoseconds lateness, uint64_t missed) {
+	std::chrono::microseconds lateness_us = std::chrono::duration_cast<std::chrono::microseconds>(lateness);
+	std::size_t bucket = jitter_bucket(lateness);
+	bool report = false;
+	Statistics report_window;
+	{
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		for (Statistics *stats : { &total, &window }) {
+			++stats->ticks;
+			stats->missed += missed;
+			stats->max_jitter = std::max(stats->max_jitter, lateness_us);
+			++stats->jitter[bucket];
+		}
+		if (window.ticks >= ticks_per_report) {
+			report = true;
+			report_window = window;
+			window = Statistics();
+		}
+	}
+	if (report) {
+		report_stats(report_window, u8"last minute");
+	}
+}
+
+void TickScheduler::report_stats(const Statistics &stats, const char *label) {
+	if (!stats.ticks) {
+		return;
+	}
+	Glib::ustring histogram;
+	for (std::size_t i = 0; i < JITTER_BUCKETS; ++i) {
+		if (stats.jitter[i]) {
+			if (!histogram.empty()) {
+				histogram.append(u8", ");
+			}
+			if (i == JITTER_BUCKETS - 1) {
+				histogram.append(Glib::ustring::compose(u8"≥%1 µs: %2", 1LL << (i - 1), stats.jitter[i]));
+			} else {
+				histogram.append(Glib::ustring::compose(u8"<%1 µs: %2", 1LL << i, stats.jitter[i]));
+			}
+		}
+	}
+	logger.write(Glib::ustring::compose(u8"Tick statistics (%1): %2 ticks, %3 missed, lateness p50 <%4 µs, p99 <%5 µs, worst %6 µs; histogram %7.", label, stats.ticks, stats.missed, jitter_percentile(stats, 0.5), jitter_percentile(stats, 0.99), stats.max_jitter.count(), histogram));
+}
@@ -0,0 +1,79 @@
+#ifndef TICKSCHEDULER_H
+#define TICKSCHEDULER_H
+
+#include "noncopyable.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include "descriptor.h"
+#endif
+
+class Logger;
+
+// Calls a function at a fixed rate on a dedicated thread, against absolute monotonic deadlines so that late ticks never shift the schedule.
+class TickScheduler : public NonCopyable {
+	public:
+		// Bucket 0 counts ticks that ran less than 1 µs late; bucket i counts ticks that ran at least 2^(i−1) µs but less than 2^i µs late.
+		// The last bucket also counts anything later than that.
+		static const std::size_t JITTER_BUCKETS = 21;
+
+		struct Statistics {
+			uint64_t ticks;
+			uint64_t missed;
+			std::chrono::microseconds max_jitter;
+			std::array<uint64_t, JITTER_BUCKETS> jitter;
+		};
+
+		TickScheduler(Logger &logger, std::chrono::microseconds period, const std::function<void()> &on_tick);
+		~TickScheduler();
+
+		// Calls a function on the scheduler thread whenever a descriptor is readable; must be called before start.
+		// Only supported on Linux; elsewhere, there is nothing to watch.
+		void watch(int fd, const std::function<void()> &on_ready);
+
+		// Starts ticking, with the first tick one period from now.
+		void start();
+
+		// Stops ticking and waits for the thread to finish; any tick in progress completes first.
+		void stop();
+
+		// Returns the totals since start.
+		Statistics statistics() const;
+
+	private:
+		struct Watch {
+			int fd;
+			std::function<void()> on_ready;
+		};
+
+		const std::chrono::microseconds period;
+		const std::function<void()> on_tick;
+		Logger &logger;
+		std::vector<Watch> watches;
+#ifdef __linux__
+		Descriptor epoll, timer, wake;
+#else
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool stopping;
+#endif
+		std::chrono::nanoseconds next_deadline;
+		mutable std::mutex stats_mutex;
+		Statistics total, window;
+		uint64_t ticks_per_report;
+		std::thread thread;
+
+		void run();
+		void record(std::chrono::nanoseconds lateness, uint64_t missed);
+		void report_stats(const Statistics &stats, const char *label);
+};
+
+#endif
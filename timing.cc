@@ -1,15 +1,44 @@
 #include "timing.h"
 
-MicrosecondCounter::MicrosecondCounter() : start_time(std::chrono::high_resolution_clock::now()) {
+Clock::~Clock() = default;
+
+SystemClock &SystemClock::instance() {
+	static SystemClock clock;
+	return clock;
+}
+
+std::chrono::microseconds SystemClock::monotonic() const {
+	// The clock is monotonic so that wall clock adjustments, such as NTP steps, never run the game clocks forwards or backwards.
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+}
+
+std::chrono::microseconds SystemClock::wall() const {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(0));
+}
+
+VirtualClock::VirtualClock(std::chrono::microseconds wall_start) : wall_start(wall_start), now(0) {
+}
+
+std::chrono::microseconds VirtualClock::monotonic() const {
+	return now;
+}
+
+std::chrono::microseconds VirtualClock::wall() const {
+	return wall_start + now;
+}
+
+void VirtualClock::advance(std::chrono::microseconds delta) {
+	now += delta;
+}
+
+MicrosecondCounter::MicrosecondCounter(const Clock &clock) : clock(clock), start_time(clock.monotonic()) {
 }
 
 uint32_t MicrosecondCounter::read_and_reset() {
-	// This computation is not exactly the same as just resetting start_time to now.
-	// In the case of a clock with better-than-microsecond resolution, this computation leaves the fractional microseconds of difference in the new value of now - start_time.
-	// This prevents error from accumulating.
-	std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-	std::chrono::microseconds diff = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time);
-	start_time += diff;
+	// Both clocks count whole microseconds, so resetting start_time to now loses nothing and error cannot accumulate.
+	std::chrono::microseconds now = clock.monotonic();
+	std::chrono::microseconds diff = now - start_time;
+	start_time = now;
 	return static_cast<uint32_t>(diff.count());
 }
 
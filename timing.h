@@ -4,13 +4,50 @@
 #include <chrono>
 #include <cstdint>
 
+// A source of time for the game engine.
+class Clock {
+	public:
+		virtual ~Clock();
+
+		// Returns a time that only ever moves forwards, for measuring elapsed time.
+		virtual std::chrono::microseconds monotonic() const = 0;
+
+		// Returns the time since the Unix epoch, for timestamps in packets and saved games.
+		virtual std::chrono::microseconds wall() const = 0;
+};
+
+// The host’s real time.
+class SystemClock : public Clock {
+	public:
+		static SystemClock &instance();
+
+		std::chrono::microseconds monotonic() const;
+		std::chrono::microseconds wall() const;
+};
+
+// A clock that stands still except when explicitly advanced, for reproducible runs faster than real time.
+class VirtualClock : public Clock {
+	public:
+		// Starts the clock at a monotonic time of zero and the given wall clock time.
+		explicit VirtualClock(std::chrono::microseconds wall_start);
+
+		std::chrono::microseconds monotonic() const;
+		std::chrono::microseconds wall() const;
+		void advance(std::chrono::microseconds delta);
+
+	private:
+		const std::chrono::microseconds wall_start;
+		std::chrono::microseconds now;
+};
+
 class MicrosecondCounter {
 	public:
-		MicrosecondCounter();
+		explicit MicrosecondCounter(const Clock &clock);
 		uint32_t read_and_reset();
 
 	private:
-		std::chrono::high_resolution_clock::time_point start_time;
+		const Clock &clock;
+		std::chrono::microseconds start_time;
 };
 
 #endif
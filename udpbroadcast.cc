@@ -3,8 +3,11 @@
 #include "exception.h"
 #include "logger.h"
 #include "noncopyable.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <utility>
 #include <glibmm/convert.h>
@@ -22,6 +25,11 @@
 #include <sys/types.h>
 #endif
 
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+
 namespace {
 	class InterfaceList;
 
@@ -30,6 +38,7 @@ namespace {
 			bool configure_socket(const Socket &sock, Logger &logger) const;
 			const std::string &name() const;
 			int family() const;
+			unsigned int index() const;
 
 			static std::vector<InterfaceInfo> all();
 
@@ -95,6 +104,14 @@ int InterfaceInfo::family() const {
 	return family_;
 }
 
+unsigned int InterfaceInfo::index() const {
+#ifdef WIN32
+	return 0;
+#else
+	return ifindex;
+#endif
+}
+
 std::vector<InterfaceInfo> InterfaceInfo::all() {
 	std::vector<InterfaceInfo> vec;
 #ifdef WIN32
@@ -135,10 +152,275 @@ InterfaceInfo::InterfaceInfo(const std::string &name, int family, unsigned int i
 
 
 
-UDPBroadcast::UDPBroadcast(Logger &logger, const std::string &host, const std::string &port, const std::string &interface) : logger(logger), interface(interface) {
+UDPTransmitter::UDPTransmitter(Logger &logger, const std::string &interface) : logger(logger), interface(interface), stats_batches(0), stats_datagrams(0), stats_syscalls(0), past_syscalls(0), stats_total_time(0), stats_max_time(0) {
 	// Initialize the sockets subsystem.
 	Socket::init_system();
 
+#ifdef __linux__
+	// Subscribe to link and address changes, so that interfaces coming and going are noticed without polling.
+	try {
+		std::unique_ptr<Socket> sock(new Socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE));
+		sockaddr_nl addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+		if (bind(*sock, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0) {
+			throw SystemError("Cannot bind netlink socket");
+		}
+		netlink = std::move(sock);
+	} catch (const SystemError &exp) {
+		logger.write(Glib::ustring::compose(u8"Network interface changes will not be noticed: %1", Glib::locale_to_utf8(exp.what())));
+	}
+#endif
+
+	// Construct the initial sockets.
+	refresh_routes();
+}
+
+int UDPTransmitter::interface_watch_fd() const {
+#ifdef __linux__
+	return netlink ? static_cast<int>(*netlink) : -1;
+#else
+	return -1;
+#endif
+}
+
+void UDPTransmitter::update_interfaces() {
+#ifdef __linux__
+	if (!netlink) {
+		return;
+	}
+
+	// Drain every pending notification, and refresh the sockets once if any of them describe a relevant change.
+	bool changed = false;
+	for (;;) {
+		alignas(nlmsghdr) char buffer[8192];
+		ssize_t ssz = recv(*netlink, buffer, sizeof(buffer), 0);
+		if (ssz < 0) {
+			int rc = errno;
+			if (rc == ENOBUFS) {
+				// Some notifications were lost, so assume the worst.
+				changed = true;
+				continue;
+			}
+			if (rc != EAGAIN && rc != EWOULDBLOCK && rc != EINTR) {
+				logger.write(Glib::ustring::compose(u8"Failed to read network interface changes: %1", Glib::locale_to_utf8(std::strerror(rc))));
+			}
+			if (rc == EINTR) {
+				continue;
+			}
+			break;
+		}
+		std::size_t len = static_cast<std::size_t>(ssz);
+		for (const nlmsghdr *hdr = reinterpret_cast<const nlmsghdr *>(buffer); NLMSG_OK(hdr, len); hdr = NLMSG_NEXT(hdr, len)) {
+			switch (hdr->nlmsg_type) {
+				case RTM_NEWLINK:
+				case RTM_DELLINK:
+				case RTM_NEWADDR:
+				case RTM_DELADDR:
+					changed = true;
+					break;
+			}
+		}
+	}
+
+	if (changed) {
+		refresh_routes();
+	}
+#endif
+}
+
+void UDPTransmitter::refresh_routes() {
+	// Find the interfaces that should be sent on now.
+	std::vector<InterfaceInfo> current;
+	try {
+		for (const InterfaceInfo &i : InterfaceInfo::all()) {
+			// If the interface name was provided in the configuration file, ignore any interface that does not match that name.
+			if (interface.empty() || i.name() == interface) {
+				current.push_back(i);
+			}
+		}
+	} catch (const SystemError &exp) {
+		logger.write(Glib::ustring::compose(u8"Failed to list network interfaces: %1", Glib::locale_to_utf8(exp.what())));
+		return;
+	}
+
+	// Drop the sockets of any interfaces that have gone away, leaving all others untouched.
+	for (auto i = routes.begin(); i != routes.end(); ) {
+		bool present = false;
+		for (const InterfaceInfo &j : current) {
+			present = present || (i->interface == j.name() && i->family == j.family() && i->ifindex == j.index());
+		}
+		if (present) {
+			++i;
+		} else {
+			logger.write(Glib::ustring::compose(u8"Stopped sending on interface %1 (%2).", Glib::locale_to_utf8(i->interface), i->family == AF_INET ? u8"IPv4" : u8"IPv6"));
+			i = routes.erase(i);
+		}
+	}
+
+	// Construct a socket for each new interface and family.
+	// An interface with several addresses of one family is listed several times, but only needs one socket.
+	for (const InterfaceInfo &i : current) {
+		bool exists = false;
+		for (const Route &route : routes) {
+			exists = exists || (route.interface == i.name() && route.family == i.family() && route.ifindex == i.index());
+		}
+		if (exists) {
+			continue;
+		}
+
+		try {
+			// Create the socket.
+			Socket sock(i.family(), SOCK_DGRAM, 0);
+
+			// Permit broadcasts, but don’t worry if it fails.
+			static const int one = 1;
+			setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+			// Permit multicast loop to the local machine, but don’t worry if it fails (Windows/UNIX disagree on whether this happens on the send or the receive path).
+			if (i.family() == AF_INET) {
+				setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+			} else {
+				setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &one, sizeof(one));
+			}
+
+			// Bind multicast transmission to the interface once and for all.
+			if (i.configure_socket(sock, logger)) {
+				logger.write(Glib::ustring::compose(u8"Sending on interface %1 (%2).", Glib::locale_to_utf8(i.name()), i.family() == AF_INET ? u8"IPv4" : u8"IPv6"));
+				routes.push_back(Route{i.name(), i.family(), i.index(), std::move(sock)});
+			}
+		} catch (const SystemError &exp) {
+			logger.write(Glib::ustring::compose(u8"Failed to create socket for interface %1: %2", Glib::locale_to_utf8(i.name()), Glib::locale_to_utf8(exp.what())));
+		}
+	}
+}
+
+std::size_t UDPTransmitter::add_destination(const sockaddr *addr, socklen_t addr_len, const std::string &host, const std::string &port) {
+	Destination dest;
+	std::memset(&dest.addr, 0, sizeof(dest.addr));
+	std::memcpy(&dest.addr, addr, std::min(static_cast<std::size_t>(addr_len), sizeof(dest.addr)));
+	dest.addr_len = addr_len;
+	dest.host = host;
+	dest.port = port;
+	destinations.push_back(dest);
+	return destinations.size() - 1;
+}
+
+void UDPTransmitter::queue(const std::vector<std::size_t> &dests, const void *data, std::size_t length) {
+	// Copy the datagram once, no matter how many destinations it goes to; the buffer keeps its capacity across batches.
+	std::size_t offset = this->data.size();
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	this->data.insert(this->data.end(), bytes, bytes + length);
+	for (std::size_t dest : dests) {
+		datagrams.push_back(Datagram{dest, offset, length});
+	}
+}
+
+void UDPTransmitter::flush() {
+	if (datagrams.empty()) {
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (const Route &route : routes) {
+#ifdef __linux__
+		// Gather every datagram whose destination is of this socket’s family into one sendmmsg call.
+		// The scratch vectors are members so that they keep their capacity from batch to batch.
+		batch.clear();
+		iovs.clear();
+		for (const Datagram &datagram : datagrams) {
+			if (destinations[datagram.dest].addr.ss_family == route.family) {
+				iovs.push_back(iovec{&data[datagram.offset], datagram.length});
+				batch.push_back(&datagram);
+			}
+		}
+		msgs.resize(batch.size());
+		for (std::size_t j = 0; j < batch.size(); ++j) {
+			Destination &dest = destinations[batch[j]->dest];
+			std::memset(&msgs[j], 0, sizeof(msgs[j]));
+			msgs[j].msg_hdr.msg_name = &dest.addr;
+			msgs[j].msg_hdr.msg_namelen = dest.addr_len;
+			msgs[j].msg_hdr.msg_iov = &iovs[j];
+			msgs[j].msg_hdr.msg_iovlen = 1;
+		}
+		std::size_t sent = 0;
+		while (sent < msgs.size()) {
+			int rc = sendmmsg(route.sock, &msgs[sent], static_cast<unsigned int>(msgs.size() - sent), MSG_NOSIGNAL);
+			++stats_syscalls;
+			if (rc < 0) {
+				// The first remaining datagram failed; report it and carry on with the rest.
+				report_send_error(route, *batch[sent], errno);
+				++sent;
+			} else {
+				for (std::size_t j = sent; j < sent + static_cast<std::size_t>(rc); ++j) {
+					if (msgs[j].msg_len != batch[j]->length) {
+						logger.write(Glib::ustring::compose(u8"Short write sending on interface %1 to address %2 and port %3!", Glib::locale_to_utf8(route.interface), Glib::locale_to_utf8(destinations[batch[j]->dest].host), Glib::locale_to_utf8(destinations[batch[j]->dest].port)));
+					}
+				}
+				sent += static_cast<std::size_t>(rc);
+				stats_datagrams += static_cast<uint64_t>(rc);
+			}
+		}
+#else
+		// Without sendmmsg, send the datagrams one at a time.
+		for (const Datagram &datagram : datagrams) {
+			const Destination &dest = destinations[datagram.dest];
+			if (dest.addr.ss_family != route.family) {
+				continue;
+			}
+#ifdef __APPLE__
+			ssize_t ssz = ::sendto(route.sock, &data[datagram.offset], datagram.length, 0, reinterpret_cast<const sockaddr *>(&dest.addr), dest.addr_len);
+#else
+			ssize_t ssz = ::sendto(route.sock, reinterpret_cast<const char *>(&data[datagram.offset]), static_cast<int>(datagram.length), 0, reinterpret_cast<const sockaddr *>(&dest.addr), dest.addr_len);
+#endif
+			++stats_syscalls;
+			if (ssz < 0) {
+				report_send_error(route, datagram, errno);
+			} else if (ssz != static_cast<ssize_t>(datagram.length)) {
+				logger.write(Glib::ustring::compose(u8"Short write sending on interface %1 to address %2 and port %3!", Glib::locale_to_utf8(route.interface), Glib::locale_to_utf8(dest.host), Glib::locale_to_utf8(dest.port)));
+			} else {
+				++stats_datagrams;
+			}
+		}
+#endif
+	}
+	datagrams.clear();
+	data.clear();
+
+	// Keep statistics and report them every so often.
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+	stats_total_time += elapsed;
+	stats_max_time = std::max(stats_max_time, elapsed);
+	if (++stats_batches == STATS_INTERVAL) {
+		report_stats();
+	}
+}
+
+uint64_t UDPTransmitter::system_calls() const {
+	return past_syscalls + stats_syscalls;
+}
+
+void UDPTransmitter::report_send_error(const Route &route, const Datagram &datagram, int rc) {
+	const Destination &dest = destinations[datagram.dest];
+	logger.write(Glib::ustring::compose(u8"Failed to send on interface %1 to address %2 and port %3: %4", Glib::locale_to_utf8(route.interface), Glib::locale_to_utf8(dest.host), Glib::locale_to_utf8(dest.port), Glib::locale_to_utf8(std::strerror(rc))));
+}
+
+void UDPTransmitter::report_stats() {
+	long long mean = std::chrono::duration_cast<std::chrono::microseconds>(stats_total_time).count() / stats_batches;
+	long long max = std::chrono::duration_cast<std::chrono::microseconds>(stats_max_time).count();
+	logger.write(Glib::ustring::compose(u8"Transmit statistics: %1 batches, %2 datagrams, %3 system calls, %4 µs mean and %5 µs worst time per batch.", stats_batches, stats_datagrams, stats_syscalls, mean, max));
+	stats_batches = 0;
+	stats_datagrams = 0;
+	past_syscalls += stats_syscalls;
+	stats_syscalls = 0;
+	stats_total_time = std::chrono::steady_clock::duration::zero();
+	stats_max_time = std::chrono::steady_clock::duration::zero();
+}
+
+
+
+UDPBroadcast::UDPBroadcast(UDPTransmitter &transmitter, const std::string &host, const std::string &port) : transmitter(transmitter) {
 	// Look up the target host/IP and port.
 	addrinfo hints;
 	hints.ai_flags = 0;
@@ -147,74 +429,20 @@ UDPBroadcast::UDPBroadcast(Logger &logger, const std::string &host, const std::s
 	hints.ai_protocol = 0;
 	AddrInfoList ai(host.c_str(), port.c_str(), &hints);
 
-	// Construct a socket for each destination.
+	// Register each destination with the transmitter.
 	for (const addrinfo *i = ai.get(); i; i = i->ai_next) {
 		// We only handle IPv4 and IPv6, because we do not know how to do multicast configuration sockopts for other families.
 		if (i->ai_family == AF_INET || i->ai_family == AF_INET6) {
 			// Do a reverse lookup to get the numeric host and port.
 			char host[256], serv[256];
 			if (getnameinfo(i->ai_addr, i->ai_addrlen, host, sizeof(host), serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
-				try {
-					// Create the socket.
-					Socket sock(i->ai_family, i->ai_socktype, i->ai_protocol);
-
-					// Permit broadcasts, but don’t worry if it fails.
-					static const int one = 1;
-					setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
-
-					// Permit multicast loop to the local machine, but don’t worry if it fails (Windows/UNIX disagree on whether this happens on the send or the receive path).
-					if (i->ai_family == AF_INET) {
-						setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
-					} else {
-						setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &one, sizeof(one));
-					}
-
-					// Lock in a default destination address.
-					if (connect(sock, i->ai_addr, i->ai_addrlen) < 0) {
-						throw SystemError("Cannot connect socket");
-					}
-
-					// Drop the socket into the map keyed by family.
-					sockets[i->ai_family].push_back(std::make_pair(std::make_pair(std::string(host), std::string(serv)), std::move(sock)));
-				} catch (const SystemError &exp) {
-					logger.write(Glib::ustring::compose(u8"Failed to create socket for destination address %1 and port %2: %3", Glib::locale_to_utf8(host), Glib::locale_to_utf8(serv), Glib::locale_to_utf8(exp.what())));
-				}
+				dests.push_back(transmitter.add_destination(i->ai_addr, static_cast<socklen_t>(i->ai_addrlen), host, serv));
 			}
 		}
 	}
 }
 
 void UDPBroadcast::send(const void *data, size_t length) {
-	// Go through the interfaces.
-	static std::vector<InterfaceInfo> interfaces = InterfaceInfo::all();
-	for (const InterfaceInfo &i : interfaces) {
-		// If the interface name was provided in the configuration file, ignore any interface that does not match that name.
-		if (!interface.empty() && i.name() != interface) {
-			continue;
-		}
-
-		// Go through all the sockets whose families match the family of this interface.
-		auto socks = sockets.find(i.family());
-		if (socks == sockets.end()) {
-			continue;
-		}
-		for (const std::pair<std::pair<std::string, std::string>, Socket> &sock : socks->second) {
-			if (i.configure_socket(sock.second, logger)) {
-				// The socket was set up to send to this interface.
-				// Now send data.
-#ifdef __APPLE__
-				ssize_t ssz = ::send(sock.second, data, length, 0);
-#else
-				ssize_t ssz = ::send(sock.second, data, length, MSG_NOSIGNAL);
-#endif
-				if (ssz < 0) {
-					int rc = errno;
-					logger.write(Glib::ustring::compose(u8"Failed to send on interface %1 to address %2 and port %3: %4", Glib::locale_to_utf8(i.name()), Glib::locale_to_utf8(sock.first.first), Glib::locale_to_utf8(sock.first.second), Glib::locale_to_utf8(std::strerror(rc))));
-				} else if (ssz != static_cast<ssize_t>(length)) {
-					logger.write(Glib::ustring::compose(u8"Short write sending on interface %1 to address %2 and port %3!", Glib::locale_to_utf8(i.name()), Glib::locale_to_utf8(sock.first.first), Glib::locale_to_utf8(sock.first.second)));
-				}
-			}
-		}
-	}
+	// The datagram goes out with the transmitter’s next flush.
+	transmitter.queue(dests, data, length);
 }
-
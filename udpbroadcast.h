@@ -1,24 +1,104 @@
 #ifndef UDP_BROADCAST_H
 #define UDP_BROADCAST_H
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
+#include "noncopyable.h"
 #include "socket.h"
 
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+
 class Logger;
 
+// Collects the datagrams produced by all publishers and transmits them together.
+class UDPTransmitter : public NonCopyable {
+	public:
+		UDPTransmitter(Logger &logger, const std::string &interface);
+
+		// Registers a destination address and returns its index.
+		std::size_t add_destination(const sockaddr *addr, socklen_t addr_len, const std::string &host, const std::string &port);
+
+		// Queues a copy of a datagram to be sent to each of a set of destinations on every interface.
+		void queue(const std::vector<std::size_t> &dests, const void *data, std::size_t length);
+
+		// Sends everything queued since the last flush, with one batched system call per socket where the platform allows.
+		void flush();
+
+		// Returns a descriptor that becomes readable when network interfaces change, or −1 if changes cannot be watched on this platform.
+		int interface_watch_fd() const;
+
+		// Brings the sockets up to date with any network interface changes; call when the watch descriptor becomes readable.
+		void update_interfaces();
+
+		// Returns the number of send system calls made since construction.
+		uint64_t system_calls() const;
+
+	private:
+		// A socket bound to send multicast packets on one interface.
+		struct Route {
+			std::string interface;
+			int family;
+			unsigned int ifindex;
+			Socket sock;
+		};
+
+		struct Destination {
+			sockaddr_storage addr;
+			socklen_t addr_len;
+			std::string host, port;
+		};
+
+		struct Datagram {
+			std::size_t dest, offset, length;
+		};
+
+		// Batches between statistics reports, roughly one minute at the default publish rate.
+		static const unsigned int STATS_INTERVAL = 2400;
+
+		Logger &logger;
+		const std::string interface;
+#ifdef __linux__
+		std::unique_ptr<Socket> netlink;
+#endif
+		std::vector<Route> routes;
+		std::vector<Destination> destinations;
+		std::vector<Datagram> datagrams;
+		std::vector<uint8_t> data;
+#ifdef __linux__
+		std::vector<const Datagram *> batch;
+		std::vector<iovec> iovs;
+		std::vector<mmsghdr> msgs;
+#endif
+		unsigned int stats_batches;
+		uint64_t stats_datagrams, stats_syscalls;
+		uint64_t past_syscalls;
+		std::chrono::steady_clock::duration stats_total_time, stats_max_time;
+
+		void refresh_routes();
+		void report_send_error(const Route &route, const Datagram &datagram, int rc);
+		void report_stats();
+};
+
+// Sends datagrams to one destination host and port through a shared transmitter.
 class UDPBroadcast {
 	public:
-		UDPBroadcast(Logger &logger, const std::string &host, const std::string &port, const std::string &interface);
+		UDPBroadcast(UDPTransmitter &transmitter, const std::string &host, const std::string &port);
 		void send(const void *data, std::size_t length);
 
 	private:
-		Logger &logger;
-		std::string interface;
-		std::unordered_map<int, std::vector<std::pair<std::pair<std::string, std::string>, Socket>>> sockets;
+		UDPTransmitter &transmitter;
+		std::vector<std::size_t> dests;
 };
 
 #endif
-